@@ -0,0 +1,65 @@
+#pragma once
+
+extern "C"{
+#include <X11/Xlib.h>
+}
+
+#include <vector>
+
+// Everything WindowManager asks of the X server.
+// Calls mirror their Xlib namesakes minus the display argument,
+// with list results returned in vectors instead of Xlib allocations.
+class XBackend{
+    public:
+      virtual ~XBackend() {}
+
+      // Connection
+      virtual Window Root() = 0;
+      virtual const char* DisplayName() = 0;
+      virtual bool SelectRootInput(long event_mask) = 0; // false if another WM already has redirection
+      virtual bool NextEvent(XEvent* e) = 0; // false once the connection is lost
+      virtual int Pending() = 0;
+      virtual void Sync() = 0;
+      virtual unsigned long NextRequestSerial() = 0; // sequence number of the next request
+      virtual XID ResourceMask() = 0; // bits of a resource ID chosen by the owning client
+      virtual void GrabServer() = 0;
+      virtual void UngrabServer() = 0;
+      virtual Atom InternAtom(const char* name) = 0;
+
+      // Windows
+      virtual Window CreateSimpleWindow(Window parent, int x, int y, unsigned int width, unsigned int height,
+                                        unsigned int border_width, unsigned long border, unsigned long background) = 0;
+      virtual void DestroyWindow(Window w) = 0;
+      virtual void SelectInput(Window w, long event_mask) = 0;
+      virtual void MapWindow(Window w) = 0;
+      virtual void UnmapWindow(Window w) = 0;
+      virtual void ReparentWindow(Window w, Window parent, int x, int y) = 0;
+      virtual void ConfigureWindow(Window w, unsigned int value_mask, XWindowChanges* changes) = 0;
+      virtual void MoveWindow(Window w, int x, int y) = 0;
+      virtual void ResizeWindow(Window w, unsigned int width, unsigned int height) = 0;
+      virtual void MoveResizeWindow(Window w, int x, int y, unsigned int width, unsigned int height) = 0;
+      virtual void RaiseWindow(Window w) = 0;
+      virtual void RestackWindows(Window* windows, int count) = 0;
+      virtual bool GetWindowAttributes(Window w, XWindowAttributes* attributes) = 0;
+      virtual bool GetGeometry(Window w, int* x, int* y, unsigned int* width, unsigned int* height) = 0;
+      virtual bool QueryTree(Window w, ::std::vector<Window>& children) = 0; // bottom to top
+
+      // Properties
+      virtual bool GetTransientForHint(Window w, Window* transient_for) = 0;
+      virtual bool GetAtomProperty(Window w, Atom property, ::std::vector<Atom>& atoms) = 0;
+      virtual void ChangeAtomProperty(Window w, Atom property, const ::std::vector<Atom>& atoms) = 0; // replaces
+      virtual bool GetWMProtocols(Window w, ::std::vector<Atom>& protocols) = 0;
+
+      // Input and clients
+      virtual void SetInputFocus(Window focus, int revert_to) = 0;
+      virtual void GetInputFocus(Window* focus, int* revert_to) = 0;
+      virtual void GrabButton(unsigned int button, unsigned int modifiers, Window w, bool owner_events,
+                              unsigned int event_mask, int pointer_mode, int keyboard_mode) = 0;
+      virtual void GrabKey(int keycode, unsigned int modifiers, Window w, bool owner_events,
+                           int pointer_mode, int keyboard_mode) = 0;
+      virtual KeyCode KeysymToKeycode(KeySym keysym) = 0;
+      virtual void AddToSaveSet(Window w) = 0;
+      virtual void RemoveFromSaveSet(Window w) = 0;
+      virtual bool SendEvent(Window w, bool propagate, long event_mask, XEvent* e) = 0;
+      virtual void KillClient(Window w) = 0;
+};
@@ -0,0 +1,261 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include "window_manager.hpp"
+#include "fake_backend.hpp"
+
+extern "C"{
+#include <X11/keysym.h>
+}
+
+// Window manager CPU cost on a FakeBackend, with no X server latency.
+// Besides time, each benchmark reports heap allocations and the X requests
+// the window manager would have sent.
+
+using ::std::unique_ptr;
+using ::std::vector;
+using ::std::chrono::milliseconds;
+
+// Count every heap allocation in the process
+static ::std::atomic<unsigned long> allocations(0);
+
+void* operator new(size_t size){
+    allocations.fetch_add(1, ::std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw ::std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept{
+    free(p);
+}
+
+// Window manager on a fake display with clients mapped into it.
+// Time only moves when a benchmark advances it, so throttling does not
+// depend on how fast the machine runs
+struct Desktop{
+    FakeBackend* x;
+    unique_ptr<WindowManager> wm;
+    vector<Window> clients;
+    RequestThrottle::Clock::time_point now;
+
+    Desktop()
+        : now(milliseconds(1))
+    {
+        unique_ptr<FakeBackend> backend(new FakeBackend());
+        x = backend.get();
+        wm = WindowManager::Create(::std::move(backend));
+        wm->SetClock([this]{ return now; });
+        CHECK(wm->Manage());
+    }
+
+    // Handles everything queued as one batch
+    void Drain(){
+        XEvent e;
+        while (x->Pending()){
+            x->NextEvent(&e);
+            wm->HandleEvent(e);
+        }
+        wm->EndBatch();
+    }
+
+    void Map(int count){
+        for (int i = 0; i < count; i++){
+            const Window w = x->AddClient((i * 37) % 1600, (i * 23) % 900, 320, 240);
+            clients.push_back(w);
+
+            XEvent e = {};
+            e.type = MapRequest;
+            e.xmaprequest.parent = x->Root();
+            e.xmaprequest.window = w;
+            x->Push(e);
+        }
+    }
+};
+
+static XEvent buttonPress(Window w, unsigned int button){
+    XEvent e = {};
+    e.type = ButtonPress;
+    e.xbutton.window = w;
+    e.xbutton.button = button;
+    e.xbutton.state = Mod1Mask;
+    return e;
+}
+
+static XEvent motion(Window w, int x_root, int y_root, unsigned int state){
+    XEvent e = {};
+    e.type = MotionNotify;
+    e.xmotion.window = w;
+    e.xmotion.x_root = x_root;
+    e.xmotion.y_root = y_root;
+    e.xmotion.state = Mod1Mask | state;
+    return e;
+}
+
+static XEvent configureRequest(Window w, int x, int y, int width, int height){
+    XEvent e = {};
+    e.type = ConfigureRequest;
+    e.xconfigurerequest.window = w;
+    e.xconfigurerequest.x = x;
+    e.xconfigurerequest.y = y;
+    e.xconfigurerequest.width = width;
+    e.xconfigurerequest.height = height;
+    e.xconfigurerequest.value_mask = CWX | CWY | CWWidth | CWHeight;
+    return e;
+}
+
+static void report(benchmark::State& state, unsigned long allocs, unsigned long requests, double per){
+    state.counters["allocs"] = benchmark::Counter(allocs / per, benchmark::Counter::kAvgIterations);
+    state.counters["X requests"] = benchmark::Counter(requests / per, benchmark::Counter::kAvgIterations);
+}
+
+// Mapping N new clients, each into its own frame
+static void BM_MapClients(benchmark::State& state){
+    const int count = state.range(0);
+    unsigned long allocs = 0, requests = 0;
+
+    // Built and torn down with timing paused, only the mapping is measured
+    unique_ptr<Desktop> desktop;
+
+    for (auto _ : state){
+        state.PauseTiming();
+        desktop.reset(new Desktop());
+        desktop->Map(count);
+        const unsigned long first_alloc = allocations;
+        const unsigned long first_request = desktop->x->Requests();
+        state.ResumeTiming();
+
+        desktop->Drain();
+
+        state.PauseTiming();
+        allocs += allocations - first_alloc;
+        requests += desktop->x->Requests() - first_request;
+        desktop.reset();
+        state.ResumeTiming();
+    }
+
+    report(state, allocs, requests, count);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_MapClients)->Arg(100)->Arg(1000)->Arg(4000)->Unit(benchmark::kMillisecond);
+
+// Resize-drag of a frame tiling N clients, ie. buildFrame() per motion event
+static void BM_TileFrame(benchmark::State& state){
+    const int count = state.range(0);
+
+    Desktop desktop;
+    desktop.Map(1);
+    desktop.Drain();
+
+    // Further clients open in the focused frame
+    desktop.x->SetInputFocus(desktop.clients.front(), RevertToPointerRoot);
+    desktop.Map(count - 1);
+    desktop.Drain();
+
+    const Window w = desktop.clients.front();
+    desktop.wm->HandleEvent(buttonPress(w, Button3));
+
+    const unsigned long first_alloc = allocations;
+    const unsigned long first_request = desktop.x->Requests();
+    int step = 0;
+
+    for (auto _ : state){
+        desktop.wm->HandleEvent(motion(w, 100 + step % 200, 100 + step % 150, Button3Mask));
+        step++;
+    }
+
+    report(state, allocations - first_alloc, desktop.x->Requests() - first_request, 1);
+}
+BENCHMARK(BM_TileFrame)->Arg(16)->Arg(256)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// Clicking through N frames, each click restacks all of them
+static void BM_RaiseFrames(benchmark::State& state){
+    const int count = state.range(0);
+
+    Desktop desktop;
+    desktop.Map(count);
+    desktop.Drain();
+
+    const unsigned long first_alloc = allocations;
+    const unsigned long first_request = desktop.x->Requests();
+    size_t next = 0;
+
+    for (auto _ : state){
+        desktop.wm->HandleEvent(buttonPress(desktop.clients[next], Button1));
+        desktop.wm->EndBatch();
+        next = (next + 1) % desktop.clients.size();
+    }
+
+    report(state, allocations - first_alloc, desktop.x->Requests() - first_request, 1);
+}
+BENCHMARK(BM_RaiseFrames)->Arg(100)->Arg(1000)->Arg(4000)->Unit(benchmark::kMicrosecond);
+
+// One client flooding configure requests among N quiet ones, per batch of 1000 in 10ms
+static void BM_ConfigureFlood(benchmark::State& state){
+    const int count = state.range(0);
+    const int flood = 1000;
+
+    Desktop desktop;
+    desktop.Map(count);
+    desktop.Drain();
+
+    const Window w = desktop.clients.front();
+    const unsigned long first_alloc = allocations;
+    const unsigned long first_request = desktop.x->Requests();
+
+    for (auto _ : state){
+        for (int i = 0; i < flood; i++){
+            desktop.wm->HandleEvent(configureRequest(w, i % 100, i % 50, 200 + i % 300, 150 + i % 200));
+        }
+        desktop.wm->EndBatch();
+        desktop.now += milliseconds(10);
+    }
+
+    report(state, allocations - first_alloc, desktop.x->Requests() - first_request, flood);
+    state.SetItemsProcessed(state.iterations() * flood);
+}
+BENCHMARK(BM_ConfigureFlood)->Arg(1)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Alt+Tab through N frames
+static void BM_AltTab(benchmark::State& state){
+    const int count = state.range(0);
+
+    Desktop desktop;
+    desktop.Map(count);
+    desktop.Drain();
+
+    XEvent e = {};
+    e.type = KeyPress;
+    e.xkey.state = Mod1Mask;
+    e.xkey.keycode = desktop.x->KeysymToKeycode(XK_Tab);
+
+    const unsigned long first_alloc = allocations;
+    const unsigned long first_request = desktop.x->Requests();
+    size_t next = 0;
+
+    for (auto _ : state){
+        e.xkey.window = desktop.clients[next];
+        desktop.wm->HandleEvent(e);
+        desktop.wm->EndBatch();
+        next = (next + 1) % desktop.clients.size();
+    }
+
+    report(state, allocations - first_alloc, desktop.x->Requests() - first_request, 1);
+}
+BENCHMARK(BM_AltTab)->Arg(100)->Arg(1000)->Arg(4000)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv){
+    ::google::InitGoogleLogging(argv[0]);
+    FLAGS_minloglevel = ::google::GLOG_ERROR; // handlers log every event
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return EXIT_SUCCESS;
+}
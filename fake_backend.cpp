@@ -0,0 +1,435 @@
+#include "fake_backend.hpp"
+
+#include "glog/logging.h"
+#include <algorithm>
+#include <cstring>
+
+using ::std::vector;
+using ::std::string;
+
+// Resource ID ranges, as a server would hand them out
+const Window FAKE_ROOT = 0x100;
+const Window FAKE_WM_BASE = 0x200000;
+const XID FAKE_CLIENT_BASE = 0x400000;
+const XID FAKE_CLIENT_RANGE = 0x40000;
+
+const Atom FAKE_FIRST_ATOM = 69; // after the predefined atoms
+
+FakeBackend::FakeBackend(unsigned int width, unsigned int height)
+    : root_(FAKE_ROOT),
+      nextWindow_(FAKE_WM_BASE + 1),
+      nextClient_(FAKE_CLIENT_BASE),
+      resourceMask_(FAKE_CLIENT_RANGE - 1),
+      focus_(PointerRoot),
+      revertTo_(RevertToNone),
+      request_(0)
+{
+    insert(root_, None, 0, 0, width, height, 0);
+    windows_[root_].mapped = true;
+}
+
+FakeBackend::Node* FakeBackend::find(Window w){
+    auto itr = windows_.find(w);
+    return itr == windows_.end() ? nullptr : &itr->second;
+}
+
+Window FakeBackend::insert(Window w, Window parent, int x, int y, unsigned int width, unsigned int height,
+                           unsigned int border_width){
+    Node& node = windows_[w];
+    node.parent = parent;
+    node.x = x;
+    node.y = y;
+    node.width = width;
+    node.height = height;
+    node.borderWidth = border_width;
+    node.mapped = false;
+    node.overrideRedirect = false;
+    node.eventMask = 0;
+    node.transientFor = None;
+
+    if (Node* p = find(parent)) p->children.push_back(w);
+
+    return w;
+}
+
+void FakeBackend::detach(Window w){
+    Node* node = find(w);
+    if (!node) return;
+
+    if (Node* p = find(node->parent)){
+        p->children.erase(::std::find(p->children.begin(), p->children.end(), w));
+    }
+    node->parent = None;
+}
+
+void FakeBackend::destroy(Window w){
+    Node* node = find(w);
+    if (!node || w == root_) return;
+
+    const vector<Window> children = node->children;
+    for (Window child : children){
+        destroy(child);
+    }
+
+    detach(w);
+    windows_.erase(w);
+}
+
+// Simulation
+
+Window FakeBackend::AddClient(int x, int y, unsigned int width, unsigned int height){
+    const Window w = nextClient_ + 1;
+    nextClient_ += FAKE_CLIENT_RANGE;
+
+    return AddWindow(w, x, y, width, height);
+}
+
+Window FakeBackend::AddWindow(Window w, int x, int y, unsigned int width, unsigned int height){
+    CHECK(!find(w));
+    return insert(w, root_, x, y, width, height, 0);
+}
+
+void FakeBackend::SetResourceMask(XID mask){
+    resourceMask_ = mask;
+}
+
+void FakeBackend::SetTransientFor(Window w, Window transient_for){
+    if (Node* node = find(w)) node->transientFor = transient_for;
+}
+
+void FakeBackend::SetAtomProperty(Window w, Atom property, const vector<Atom>& atoms){
+    if (Node* node = find(w)) node->properties[property] = atoms;
+}
+
+void FakeBackend::SetWMProtocols(Window w, const vector<Atom>& protocols){
+    if (Node* node = find(w)) node->protocols = protocols;
+}
+
+void FakeBackend::Push(const XEvent& e){
+    events_.push_back(e);
+}
+
+// Connection
+
+Window FakeBackend::Root(){
+    return root_;
+}
+
+const char* FakeBackend::DisplayName(){
+    return "(fake)";
+}
+
+bool FakeBackend::SelectRootInput(long event_mask){
+    request_ += 2; // select + sync
+    windows_[root_].eventMask = event_mask;
+    return true;
+}
+
+bool FakeBackend::NextEvent(XEvent* e){
+    // Running out of events is the fake's lost connection
+    if (events_.empty()) return false;
+
+    *e = events_.front();
+    events_.pop_front();
+    return true;
+}
+
+int FakeBackend::Pending(){
+    return events_.size();
+}
+
+void FakeBackend::Sync(){
+    request_++;
+}
+
+unsigned long FakeBackend::NextRequestSerial(){
+    return request_ + 1;
+}
+
+XID FakeBackend::ResourceMask(){
+    return resourceMask_;
+}
+
+void FakeBackend::GrabServer(){
+    request_++;
+}
+
+void FakeBackend::UngrabServer(){
+    request_++;
+}
+
+Atom FakeBackend::InternAtom(const char* name){
+    request_++;
+    auto itr = atoms_.find(name);
+    if (itr != atoms_.end()) return itr->second;
+
+    const Atom atom = FAKE_FIRST_ATOM + atoms_.size();
+    atoms_.insert({ name, atom });
+    return atom;
+}
+
+// Windows
+
+Window FakeBackend::CreateSimpleWindow(Window parent, int x, int y, unsigned int width, unsigned int height,
+                                       unsigned int border_width, unsigned long border, unsigned long background){
+    request_++;
+    while (find(nextWindow_)) nextWindow_++; // skip ids taken by AddWindow()
+    return insert(nextWindow_++, parent, x, y, width, height, border_width);
+}
+
+void FakeBackend::DestroyWindow(Window w){
+    request_++;
+    destroy(w);
+}
+
+void FakeBackend::SelectInput(Window w, long event_mask){
+    request_++;
+    if (Node* node = find(w)) node->eventMask = event_mask;
+}
+
+void FakeBackend::MapWindow(Window w){
+    request_++;
+    if (Node* node = find(w)) node->mapped = true;
+}
+
+void FakeBackend::UnmapWindow(Window w){
+    request_++;
+    if (Node* node = find(w)) node->mapped = false;
+}
+
+void FakeBackend::ReparentWindow(Window w, Window parent, int x, int y){
+    request_++;
+    Node* node = find(w);
+    Node* p = find(parent);
+    if (!node || !p) return;
+
+    detach(w);
+    node->parent = parent;
+    node->x = x;
+    node->y = y;
+    p->children.push_back(w);
+}
+
+void FakeBackend::ConfigureWindow(Window w, unsigned int value_mask, XWindowChanges* changes){
+    request_++;
+    Node* node = find(w);
+    if (!node) return;
+
+    if (value_mask & CWX) node->x = changes->x;
+    if (value_mask & CWY) node->y = changes->y;
+    if (value_mask & CWWidth) node->width = changes->width;
+    if (value_mask & CWHeight) node->height = changes->height;
+    if (value_mask & CWBorderWidth) node->borderWidth = changes->border_width;
+
+    // Sibling is ignored, Above/Below go to the top/bottom of the parent
+    if ((value_mask & CWStackMode) && (changes->stack_mode == Above || changes->stack_mode == Below)){
+        Node* p = find(node->parent);
+        if (!p) return;
+
+        p->children.erase(::std::find(p->children.begin(), p->children.end(), w));
+        if (changes->stack_mode == Above) p->children.push_back(w);
+        else p->children.insert(p->children.begin(), w);
+    }
+}
+
+void FakeBackend::MoveWindow(Window w, int x, int y){
+    request_++;
+    if (Node* node = find(w)){
+        node->x = x;
+        node->y = y;
+    }
+}
+
+void FakeBackend::ResizeWindow(Window w, unsigned int width, unsigned int height){
+    request_++;
+    if (Node* node = find(w)){
+        node->width = width;
+        node->height = height;
+    }
+}
+
+void FakeBackend::MoveResizeWindow(Window w, int x, int y, unsigned int width, unsigned int height){
+    request_++;
+    if (Node* node = find(w)){
+        node->x = x;
+        node->y = y;
+        node->width = width;
+        node->height = height;
+    }
+}
+
+void FakeBackend::RaiseWindow(Window w){
+    request_++;
+    Node* node = find(w);
+    if (!node) return;
+    Node* p = find(node->parent);
+    if (!p) return;
+
+    p->children.erase(::std::find(p->children.begin(), p->children.end(), w));
+    p->children.push_back(w);
+}
+
+void FakeBackend::RestackWindows(Window* windows, int count){
+    request_++;
+    if (count < 2) return;
+
+    Node* first = find(windows[0]);
+    if (!first) return;
+    Node* p = find(first->parent);
+    if (!p) return;
+
+    // windows[1..] end up directly below windows[0], in order
+    vector<Window>& moved = scratch_;
+    moved.assign(windows + 1, windows + count);
+    ::std::sort(moved.begin(), moved.end());
+
+    order_.clear();
+    for (Window child : p->children){
+        if (::std::binary_search(moved.begin(), moved.end(), child)) continue;
+        if (child == windows[0]){
+            for (int i = count - 1; i > 0; i--){
+                order_.push_back(windows[i]);
+            }
+        }
+        order_.push_back(child);
+    }
+
+    p->children.swap(order_);
+}
+
+bool FakeBackend::GetWindowAttributes(Window w, XWindowAttributes* attributes){
+    request_++;
+    Node* node = find(w);
+    if (!node) return false;
+
+    memset(attributes, 0, sizeof(*attributes));
+    attributes->x = node->x;
+    attributes->y = node->y;
+    attributes->width = node->width;
+    attributes->height = node->height;
+    attributes->border_width = node->borderWidth;
+    attributes->root = root_;
+    attributes->override_redirect = node->overrideRedirect;
+    attributes->your_event_mask = node->eventMask;
+
+    // Viewable only if every ancestor is mapped too
+    attributes->map_state = IsViewable;
+    for (Node* n = node; n; n = find(n->parent)){
+        if (!n->mapped){
+            attributes->map_state = node->mapped ? IsUnviewable : IsUnmapped;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool FakeBackend::GetGeometry(Window w, int* x, int* y, unsigned int* width, unsigned int* height){
+    request_++;
+    Node* node = find(w);
+    if (!node) return false;
+
+    *x = node->x;
+    *y = node->y;
+    *width = node->width;
+    *height = node->height;
+    return true;
+}
+
+bool FakeBackend::QueryTree(Window w, vector<Window>& children){
+    request_++;
+    Node* node = find(w);
+    if (!node){
+        children.clear();
+        return false;
+    }
+
+    children = node->children;
+    return true;
+}
+
+// Properties
+
+bool FakeBackend::GetTransientForHint(Window w, Window* transient_for){
+    request_++;
+    Node* node = find(w);
+    if (!node || node->transientFor == None) return false;
+
+    *transient_for = node->transientFor;
+    return true;
+}
+
+bool FakeBackend::GetAtomProperty(Window w, Atom property, vector<Atom>& atoms){
+    request_++;
+    atoms.clear();
+    Node* node = find(w);
+    if (!node) return false;
+
+    auto itr = node->properties.find(property);
+    if (itr == node->properties.end()) return false;
+
+    atoms = itr->second;
+    return true;
+}
+
+void FakeBackend::ChangeAtomProperty(Window w, Atom property, const vector<Atom>& atoms){
+    request_++;
+    if (Node* node = find(w)) node->properties[property] = atoms;
+}
+
+bool FakeBackend::GetWMProtocols(Window w, vector<Atom>& protocols){
+    request_++;
+    protocols.clear();
+    Node* node = find(w);
+    if (!node || node->protocols.empty()) return false;
+
+    protocols = node->protocols;
+    return true;
+}
+
+// Input and clients
+
+void FakeBackend::SetInputFocus(Window focus, int revert_to){
+    request_++;
+    focus_ = focus;
+    revertTo_ = revert_to;
+}
+
+void FakeBackend::GetInputFocus(Window* focus, int* revert_to){
+    request_++;
+    *focus = focus_;
+    *revert_to = revertTo_;
+}
+
+void FakeBackend::GrabButton(unsigned int button, unsigned int modifiers, Window w, bool owner_events,
+                             unsigned int event_mask, int pointer_mode, int keyboard_mode){
+    request_++;
+}
+
+void FakeBackend::GrabKey(int keycode, unsigned int modifiers, Window w, bool owner_events,
+                          int pointer_mode, int keyboard_mode){
+    request_++;
+}
+
+KeyCode FakeBackend::KeysymToKeycode(KeySym keysym){
+    // Xlib answers from its cached keymap, no request
+    return keysym % 248 + 8;
+}
+
+void FakeBackend::AddToSaveSet(Window w){
+    request_++;
+}
+
+void FakeBackend::RemoveFromSaveSet(Window w){
+    request_++;
+}
+
+bool FakeBackend::SendEvent(Window w, bool propagate, long event_mask, XEvent* e){
+    request_++;
+    return find(w) != nullptr;
+}
+
+void FakeBackend::KillClient(Window w){
+    request_++;
+    destroy(w);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "backend.hpp"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// XBackend on an in-memory window tree, for benchmarking and replaying
+// the window manager without an X server. Requests are applied to the tree
+// and counted, events only arrive through Push().
+class FakeBackend : public XBackend{
+    private:
+      struct Node{
+          Window parent;
+          ::std::vector<Window> children; // bottom to top
+          int x, y;
+          unsigned int width, height, borderWidth;
+          bool mapped;
+          bool overrideRedirect;
+          long eventMask;
+          Window transientFor;
+          ::std::vector<Atom> protocols;
+          ::std::unordered_map<Atom, ::std::vector<Atom>> properties;
+      };
+
+      ::std::unordered_map<Window, Node> windows_;
+      ::std::deque<XEvent> events_;
+      ::std::unordered_map<::std::string, Atom> atoms_;
+      const Window root_;
+      Window nextWindow_; // ids of windows the window manager creates
+      XID nextClient_;    // resource base of the next simulated client
+      XID resourceMask_;
+      Window focus_;
+      int revertTo_;
+      unsigned long request_;
+      ::std::vector<Window> scratch_, order_; // reused by RestackWindows(), so it does not allocate
+
+      Node* find(Window w);
+      Window insert(Window w, Window parent, int x, int y, unsigned int width, unsigned int height,
+                    unsigned int border_width);
+      void detach(Window w);
+      void destroy(Window w);
+
+    public:
+      FakeBackend(unsigned int width = 1920, unsigned int height = 1080);
+
+      // Simulation
+      Window AddClient(int x, int y, unsigned int width, unsigned int height); // new client with one unmapped top-level
+      Window AddWindow(Window w, int x, int y, unsigned int width, unsigned int height); // top-level with a given id
+      void SetTransientFor(Window w, Window transient_for);
+      void SetAtomProperty(Window w, Atom property, const ::std::vector<Atom>& atoms);
+      void SetWMProtocols(Window w, const ::std::vector<Atom>& protocols);
+      void Push(const XEvent& e);
+      void SetResourceMask(XID mask); // eg. a recorded server's, before a window manager reads it
+      bool Contains(Window w) const { return windows_.count(w); }
+      size_t WindowCount() const { return windows_.size(); }
+      unsigned long Requests() const { return request_; }
+
+      Window Root() override;
+      const char* DisplayName() override;
+      bool SelectRootInput(long event_mask) override;
+      bool NextEvent(XEvent* e) override;
+      int Pending() override;
+      void Sync() override;
+      unsigned long NextRequestSerial() override;
+      XID ResourceMask() override;
+      void GrabServer() override;
+      void UngrabServer() override;
+      Atom InternAtom(const char* name) override;
+
+      Window CreateSimpleWindow(Window parent, int x, int y, unsigned int width, unsigned int height,
+                                unsigned int border_width, unsigned long border, unsigned long background) override;
+      void DestroyWindow(Window w) override;
+      void SelectInput(Window w, long event_mask) override;
+      void MapWindow(Window w) override;
+      void UnmapWindow(Window w) override;
+      void ReparentWindow(Window w, Window parent, int x, int y) override;
+      void ConfigureWindow(Window w, unsigned int value_mask, XWindowChanges* changes) override;
+      void MoveWindow(Window w, int x, int y) override;
+      void ResizeWindow(Window w, unsigned int width, unsigned int height) override;
+      void MoveResizeWindow(Window w, int x, int y, unsigned int width, unsigned int height) override;
+      void RaiseWindow(Window w) override;
+      void RestackWindows(Window* windows, int count) override;
+      bool GetWindowAttributes(Window w, XWindowAttributes* attributes) override;
+      bool GetGeometry(Window w, int* x, int* y, unsigned int* width, unsigned int* height) override;
+      bool QueryTree(Window w, ::std::vector<Window>& children) override;
+
+      bool GetTransientForHint(Window w, Window* transient_for) override;
+      bool GetAtomProperty(Window w, Atom property, ::std::vector<Atom>& atoms) override;
+      void ChangeAtomProperty(Window w, Atom property, const ::std::vector<Atom>& atoms) override;
+      bool GetWMProtocols(Window w, ::std::vector<Atom>& protocols) override;
+
+      void SetInputFocus(Window focus, int revert_to) override;
+      void GetInputFocus(Window* focus, int* revert_to) override;
+      void GrabButton(unsigned int button, unsigned int modifiers, Window w, bool owner_events,
+                      unsigned int event_mask, int pointer_mode, int keyboard_mode) override;
+      void GrabKey(int keycode, unsigned int modifiers, Window w, bool owner_events,
+                   int pointer_mode, int keyboard_mode) override;
+      KeyCode KeysymToKeycode(KeySym keysym) override;
+      void AddToSaveSet(Window w) override;
+      void RemoveFromSaveSet(Window w) override;
+      bool SendEvent(Window w, bool propagate, long event_mask, XEvent* e) override;
+      void KillClient(Window w) override;
+};
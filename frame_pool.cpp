@@ -0,0 +1,82 @@
+#include "frame_pool.hpp"
+
+#include "glog/logging.h"
+
+// Pool grows back to POOL_TARGET when it drops to POOL_LOW,
+// and shrinks back to it when it goes over POOL_HIGH
+const size_t POOL_LOW = 1;
+const size_t POOL_TARGET = 4;
+const size_t POOL_HIGH = 8;
+
+FramePool::FramePool(XBackend* x, Window root, unsigned int border_width,
+                     unsigned long border_colour, unsigned long bg_colour)
+    : x_(CHECK_NOTNULL(x)),
+      root_(root),
+      borderWidth_(border_width),
+      borderColour_(border_colour),
+      bgColour_(bg_colour)
+{}
+
+// Free frames are not destroyed on exit, closing the display frees them
+
+void FramePool::Fill(){
+    grow();
+}
+
+Window FramePool::Acquire(int x, int y, unsigned int width, unsigned int height){
+    if (free_.size() <= POOL_LOW) grow();
+
+    const Window frame = free_.back();
+    free_.pop_back();
+
+    // Recycled frames may carry a previous client's border width
+    XWindowChanges changes;
+    changes.x = x;
+    changes.y = y;
+    changes.width = width;
+    changes.height = height;
+    changes.border_width = borderWidth_;
+    x_->ConfigureWindow(frame, CWX | CWY | CWWidth | CWHeight | CWBorderWidth, &changes);
+
+    return frame;
+}
+
+void FramePool::Release(Window frame){
+    x_->UnmapWindow(frame);
+    free_.push_back(frame);
+
+    if (free_.size() > POOL_HIGH) shrink();
+}
+
+Window FramePool::create(){
+    const Window frame = x_->CreateSimpleWindow(
+        root_,
+        0, 0, 1, 1,
+        borderWidth_,
+        borderColour_,
+        bgColour_
+    );
+
+    // Request that X report events associated with the frame
+    x_->SelectInput(
+        frame,
+        SubstructureRedirectMask | SubstructureNotifyMask | FocusChangeMask
+    );
+
+    return frame;
+}
+
+void FramePool::grow(){
+    while (free_.size() < POOL_TARGET){
+        free_.push_back(create());
+    }
+    LOG(INFO) << "Frame pool grown to " << free_.size();
+}
+
+void FramePool::shrink(){
+    while (free_.size() > POOL_TARGET){
+        x_->DestroyWindow(free_.back());
+        free_.pop_back();
+    }
+    LOG(INFO) << "Frame pool shrunk to " << free_.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "backend.hpp"
+
+#include <vector>
+
+// Keeps unmapped frame windows around for reuse so mapping a client
+// does not have to create one, and unmapping it does not destroy one.
+class FramePool{
+    private:
+      XBackend* x_;
+      const Window root_;
+      const unsigned int borderWidth_;
+      const unsigned long borderColour_;
+      const unsigned long bgColour_;
+
+      ::std::vector<Window> free_; // unmapped frames ready for use
+
+      Window create();
+      void grow();
+      void shrink();
+
+    public:
+      FramePool(XBackend* x, Window root, unsigned int border_width,
+                unsigned long border_colour, unsigned long bg_colour);
+
+      void Fill(); // pre-create frames up to the pool target
+      Window Acquire(int x, int y, unsigned int width, unsigned int height);
+      void Release(Window frame); // frame must have no children left
+};
@@ -1,21 +1,80 @@
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 #include <glog/logging.h>
 #include "window_manager.hpp"
 
 
 
 using ::std::unique_ptr;
+using ::std::vector;
+using ::std::thread;
+using ::std::string;
 
 int main (int argc, char** argv){
     ::google::InitGoogleLogging(argv[0]);
 
-    unique_ptr<WindowManager> window_manager(WindowManager::Create());
-    if (!window_manager){
-        LOG(ERROR) << "Failed to initialise window manager. ";
+    // Displays to manage, $DISPLAY if none given
+    // --record=FILE writes the events of each display to a trace
+    vector<const char*> display_names;
+    const char* record_path = nullptr;
+
+    for (int i = 1; i < argc; i++){
+        if (!strncmp(argv[i], "--record=", 9)) record_path = argv[i] + 9;
+        else display_names.push_back(argv[i]);
+    }
+
+    if (display_names.empty()){
+        display_names.push_back(nullptr);
+    }
+
+    // Each display gets its own thread, Xlib has to know before any connection is opened
+    if (display_names.size() > 1){
+        CHECK(XInitThreads());
+    }
+
+    vector<unique_ptr<WindowManager>> window_managers;
+    for (const char* display_name : display_names){
+        unique_ptr<WindowManager> window_manager(WindowManager::Create(display_name));
+        if (!window_manager){
+            LOG(ERROR) << "Failed to initialise window manager for " << XDisplayName(display_name);
+            continue;
+        }
+        window_managers.push_back(::std::move(window_manager));
+    }
+
+    if (window_managers.empty()){
         return EXIT_FAILURE;
     }
 
-    window_manager->Run();
+    // One trace per display, numbered if there are several
+    if (record_path){
+        for (size_t i = 0; i < window_managers.size(); i++){
+            string path = record_path;
+            if (window_managers.size() > 1) path += "." + ::std::to_string(i);
+
+            if (!window_managers[i]->RecordTo(path)){
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // Single display runs on the main thread
+    if (window_managers.size() == 1){
+        window_managers.front()->Run();
+        return EXIT_SUCCESS;
+    }
+
+    vector<thread> threads;
+    for (auto& window_manager : window_managers){
+        threads.emplace_back(&WindowManager::Run, window_manager.get());
+    }
+    // A thread ends when its display is lost, the others keep running
+    for (thread& t : threads){
+        t.join();
+    }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,300 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <glog/logging.h>
+#include "window_manager.hpp"
+#include "xlib_backend.hpp"
+#include "fake_backend.hpp"
+#include "trace.hpp"
+
+// Feeds a recorded event trace back into a WindowManager on a fresh display,
+// or an in-memory fake one, and reports CPU time and X requests per handler.
+//
+//   flotise-replay [--max-speed] [--fake] TRACE [DISPLAY]
+
+using ::std::unique_ptr;
+using ::std::unordered_map;
+using ::std::chrono::steady_clock;
+using ::std::chrono::microseconds;
+using ::std::chrono::duration;
+
+// Windows standing in for the ones in the trace. Each recorded client gets
+// its own connection, so the window manager can query and reparent them,
+// throttles them per client and a kill only takes down that client.
+// On a fake display they are added under their recorded ids instead
+class StandIns{
+    private:
+      struct StandIn{
+          XBackend* x; // connection it was created on
+          Window window;
+      };
+
+      XBackend* x_;
+      FakeBackend* fake_;
+      const char* displayName_;
+      const Window recordedRoot_;
+      const XID recordedMask_;
+      const Window root_;
+      unordered_map<XID, unique_ptr<XBackend>> clients_; // recorded resource base -> connection
+      unordered_map<Window, StandIn> live_; // recorded id -> stand-in
+      bool created_;
+
+      // Connection for the recorded client owning an id, opened on first use
+      XBackend* clientOf(Window recorded){
+          if (fake_) return x_;
+
+          const XID base = recorded & ~recordedMask_;
+          auto itr = clients_.find(base);
+          if (itr != clients_.end()) return itr->second.get();
+
+          unique_ptr<XBackend> client = XlibBackend::Open(displayName_);
+          if (!client){
+              LOG(ERROR) << "Cannot open a connection for client 0x" << ::std::hex << base
+                         << ", its windows share the replay's own";
+              return x_;
+          }
+          return clients_.insert({ base, ::std::move(client) }).first->second.get();
+      }
+
+    public:
+      StandIns(XBackend* x, FakeBackend* fake, const char* display_name, const TraceHeader& recorded)
+          : x_(x),
+            fake_(fake),
+            displayName_(display_name),
+            recordedRoot_(recorded.root),
+            recordedMask_(recorded.resourceMask),
+            root_(x->Root()),
+            created_(false)
+      {}
+
+      Window Get(Window recorded, int x = 0, int y = 0, unsigned int width = 1, unsigned int height = 1){
+          if (recorded == None || recorded == PointerRoot) return recorded;
+          if (recorded == recordedRoot_) return root_;
+
+          auto itr = live_.find(recorded);
+          if (itr != live_.end()) return itr->second.window;
+
+          width = width ? width : 1;
+          height = height ? height : 1;
+
+          // Ids already in use on the fake display are taken as they are
+          if (fake_ && fake_->Contains(recorded)) return recorded;
+
+          XBackend* client = clientOf(recorded);
+          const Window w = fake_ ?
+              fake_->AddWindow(recorded, x, y, width, height) :
+              client->CreateSimpleWindow(root_, x, y, width, height, 0, 0, 0);
+          live_.insert({ recorded, StandIn{ client, w } });
+          created_ = true;
+          return w;
+      }
+
+      // Recreates a window that was mapped before recording started
+      void Map(const TraceWindow& recorded){
+          const Window w = Get(recorded.window, recorded.x, recorded.y, recorded.width, recorded.height);
+          auto itr = live_.find(recorded.window);
+          (itr != live_.end() ? itr->second.x : x_)->MapWindow(w);
+      }
+
+      void Destroy(Window recorded){
+          auto itr = live_.find(recorded);
+          if (itr == live_.end()) return;
+
+          itr->second.x->DestroyWindow(itr->second.window);
+          live_.erase(itr);
+      }
+
+      // Makes new stand-ins visible to the window manager's connection
+      void Sync(){
+          if (!fake_){
+              x_->Sync();
+              for (auto& client : clients_) client.second->Sync();
+          }
+          created_ = false;
+      }
+      bool Created() const { return created_; }
+};
+
+// Recorded atom -> the same name's atom on the replay display
+typedef unordered_map<Atom, Atom> Atoms;
+
+static Atom translateAtom(Atom recorded, const Atoms& atoms){
+    auto itr = atoms.find(recorded);
+    return itr == atoms.end() ? recorded : itr->second;
+}
+
+// Swaps recorded window ids for stand-ins, and recorded atoms for ours
+static void translate(XEvent& e, StandIns& ids, const Atoms& atoms){
+    e.xany.display = nullptr;
+
+    switch (e.type){
+        case CreateNotify:
+            e.xcreatewindow.parent = ids.Get(e.xcreatewindow.parent);
+            e.xcreatewindow.window = ids.Get(
+                e.xcreatewindow.window,
+                e.xcreatewindow.x, e.xcreatewindow.y,
+                e.xcreatewindow.width, e.xcreatewindow.height
+            );
+            break;
+        case ConfigureRequest:
+            e.xconfigurerequest.parent = ids.Get(e.xconfigurerequest.parent);
+            e.xconfigurerequest.window = ids.Get(e.xconfigurerequest.window);
+            e.xconfigurerequest.above = ids.Get(e.xconfigurerequest.above);
+            break;
+        case MapRequest:
+            e.xmaprequest.parent = ids.Get(e.xmaprequest.parent);
+            e.xmaprequest.window = ids.Get(e.xmaprequest.window);
+            break;
+        case ConfigureNotify:
+            e.xconfigure.event = ids.Get(e.xconfigure.event);
+            e.xconfigure.window = ids.Get(e.xconfigure.window);
+            e.xconfigure.above = ids.Get(e.xconfigure.above);
+            break;
+        case UnmapNotify:
+            e.xunmap.event = ids.Get(e.xunmap.event);
+            e.xunmap.window = ids.Get(e.xunmap.window);
+            break;
+        case DestroyNotify:
+            e.xdestroywindow.event = ids.Get(e.xdestroywindow.event);
+            e.xdestroywindow.window = ids.Get(e.xdestroywindow.window);
+            break;
+        case KeyPress:
+        case KeyRelease:
+            e.xkey.window = ids.Get(e.xkey.window);
+            e.xkey.root = ids.Get(e.xkey.root);
+            e.xkey.subwindow = ids.Get(e.xkey.subwindow);
+            break;
+        case ButtonPress:
+        case ButtonRelease:
+            e.xbutton.window = ids.Get(e.xbutton.window);
+            e.xbutton.root = ids.Get(e.xbutton.root);
+            e.xbutton.subwindow = ids.Get(e.xbutton.subwindow);
+            break;
+        case MotionNotify:
+            e.xmotion.window = ids.Get(e.xmotion.window);
+            e.xmotion.root = ids.Get(e.xmotion.root);
+            e.xmotion.subwindow = ids.Get(e.xmotion.subwindow);
+            break;
+        case ClientMessage:
+            e.xclient.window = ids.Get(e.xclient.window);
+            e.xclient.message_type = translateAtom(e.xclient.message_type, atoms);
+            // eg. _NET_WM_STATE carries the states as atoms, only known atoms are swapped
+            if (e.xclient.format == 32){
+                for (long& l : e.xclient.data.l){
+                    l = translateAtom(l, atoms);
+                }
+            }
+            break;
+        default:
+            e.xany.window = ids.Get(e.xany.window);
+    }
+}
+
+int main (int argc, char** argv){
+    ::google::InitGoogleLogging(argv[0]);
+
+    bool max_speed = false;
+    bool fake = false;
+    const char* trace_path = nullptr;
+    const char* display_name = nullptr;
+
+    for (int i = 1; i < argc; i++){
+        if (!strcmp(argv[i], "--max-speed")) max_speed = true;
+        else if (!strcmp(argv[i], "--fake")) fake = true;
+        else if (!trace_path) trace_path = argv[i];
+        else display_name = argv[i];
+    }
+
+    if (!trace_path){
+        fprintf(stderr, "usage: %s [--max-speed] [--fake] TRACE [DISPLAY]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unique_ptr<TraceReader> trace(TraceReader::Open(trace_path));
+    if (!trace){
+        return EXIT_FAILURE;
+    }
+
+    // Window manager, and the connection atoms are looked up on
+    unique_ptr<WindowManager> window_manager;
+    unique_ptr<XBackend> client_connection;
+    XBackend* clients;
+    FakeBackend* fake_display = nullptr;
+
+    if (fake){
+        unique_ptr<FakeBackend> backend(new FakeBackend());
+        backend->SetResourceMask(trace->Header().resourceMask);
+        fake_display = backend.get();
+        clients = backend.get();
+        window_manager = WindowManager::Create(::std::move(backend));
+    }
+    else{
+        window_manager = WindowManager::Create(display_name);
+        client_connection = XlibBackend::Open(display_name);
+        clients = client_connection.get();
+        if (!window_manager || !clients){
+            return EXIT_FAILURE;
+        }
+    }
+
+    Atoms atoms;
+    for (const TraceAtom& a : trace->Header().atoms){
+        atoms.insert({ a.atom, clients->InternAtom(a.name.c_str()) });
+    }
+
+    // Windows present when recording started, for Manage() to frame
+    StandIns ids(clients, fake_display, display_name, trace->Header());
+    for (const TraceWindow& w : trace->Header().windows){
+        ids.Map(w);
+    }
+    ids.Sync();
+
+    window_manager->EnableProfiling();
+    if (!window_manager->Manage()){
+        return EXIT_FAILURE;
+    }
+
+    // Replay
+    unsigned long events = 0, batches = 0;
+    TraceRecord record;
+
+    const steady_clock::time_point start = steady_clock::now();
+    microseconds recorded(0);
+
+    // Throttle runs on the recorded timeline, however fast the replay goes
+    window_manager->SetClock([&start, &recorded]{ return start + recorded; });
+
+    while (trace->Next(record)){
+        recorded += record.delay;
+        if (!max_speed){
+            ::std::this_thread::sleep_until(start + recorded);
+        }
+
+        if (record.endOfBatch){
+            window_manager->EndBatch();
+            batches++;
+            continue;
+        }
+
+        const Window destroyed = record.event.type == DestroyNotify ? record.event.xdestroywindow.window : None;
+
+        translate(record.event, ids, atoms);
+        if (ids.Created()) ids.Sync();
+
+        window_manager->HandleEvent(record.event);
+        events++;
+
+        if (destroyed) ids.Destroy(destroyed);
+    }
+
+    const double elapsed = duration<double>(steady_clock::now() - start).count();
+
+    printf("Replayed %lu events in %lu batches, %.3fs wall\n\n", events, batches, elapsed);
+    window_manager->WriteProfile(::std::cout);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+#include "stacking.hpp"
+
+#include "glog/logging.h"
+#include <algorithm>
+
+using ::std::vector;
+
+StackingManager::StackingManager(XBackend* x)
+    : x_(CHECK_NOTNULL(x)),
+      dirty_(false)
+{}
+
+void StackingManager::Add(Window frame, StackLayer layer, Window parent){
+    CHECK(!layerOf_.count(frame));
+
+    // Transients of unmanaged windows are stacked as normal frames
+    if (layer == StackLayer::Transient && !layerOf_.count(parent)){
+        layer = StackLayer::Normal;
+    }
+
+    if (layer == StackLayer::Transient){
+        parentOf_[frame] = parent;
+        transients_[parent].push_back(frame);
+    }
+    else{
+        layers_[static_cast<int>(layer)].push_back(frame);
+    }
+
+    layerOf_[frame] = layer;
+    dirty_ = true;
+}
+
+void StackingManager::Remove(Window frame){
+    if (!layerOf_.count(frame)) return;
+
+    detach(frame);
+    layerOf_.erase(frame);
+
+    // Orphaned transients fall back to the normal layer
+    auto itr = transients_.find(frame);
+    if (itr != transients_.end()){
+        for (Window t : itr->second){
+            parentOf_.erase(t);
+            layerOf_[t] = StackLayer::Normal;
+            layers_[static_cast<int>(StackLayer::Normal)].push_back(t);
+        }
+        transients_.erase(itr);
+    }
+
+    dirty_ = true;
+}
+
+void StackingManager::SetLayer(Window frame, StackLayer layer, Window parent){
+    CHECK(layerOf_.count(frame));
+
+    detach(frame);
+    layerOf_.erase(frame);
+    Add(frame, layer, parent);
+}
+
+void StackingManager::Raise(Window frame){
+    if (!layerOf_.count(frame)) return;
+
+    if (layerOf_[frame] == StackLayer::Transient){
+        // Raising a transient brings its parent up with it
+        Window parent = parentOf_[frame];
+        Raise(parent);
+        vector<Window>& siblings = transients_[parent];
+        siblings.erase(::std::find(siblings.begin(), siblings.end(), frame));
+        siblings.push_back(frame);
+    }
+    else{
+        ::std::list<Window>& layer = layers_[static_cast<int>(layerOf_[frame])];
+        layer.remove(frame);
+        layer.push_back(frame);
+    }
+
+    dirty_ = true;
+}
+
+void StackingManager::Lower(Window frame){
+    if (!layerOf_.count(frame)) return;
+
+    if (layerOf_[frame] == StackLayer::Transient){
+        vector<Window>& siblings = transients_[parentOf_[frame]];
+        siblings.erase(::std::find(siblings.begin(), siblings.end(), frame));
+        siblings.insert(siblings.begin(), frame);
+    }
+    else{
+        ::std::list<Window>& layer = layers_[static_cast<int>(layerOf_[frame])];
+        layer.remove(frame);
+        layer.push_front(frame);
+    }
+
+    dirty_ = true;
+}
+
+StackLayer StackingManager::LayerOf(Window frame) const{
+    auto itr = layerOf_.find(frame);
+    return itr == layerOf_.end() ? StackLayer::Normal : itr->second;
+}
+
+void StackingManager::detach(Window frame){
+    if (layerOf_[frame] == StackLayer::Transient){
+        auto itr = parentOf_.find(frame);
+        vector<Window>& siblings = transients_[itr->second];
+        siblings.erase(::std::find(siblings.begin(), siblings.end(), frame));
+        if (siblings.empty()) transients_.erase(itr->second);
+        parentOf_.erase(itr);
+    }
+    else{
+        layers_[static_cast<int>(layerOf_[frame])].remove(frame);
+    }
+}
+
+void StackingManager::collect(Window frame, vector<Window>& out) const{
+    out.push_back(frame);
+
+    auto itr = transients_.find(frame);
+    if (itr == transients_.end()) return;
+
+    for (Window t : itr->second){
+        collect(t, out);
+    }
+}
+
+void StackingManager::Flush(){
+    if (!dirty_) return;
+    dirty_ = false;
+
+    // 1. Build order bottom to top, then flip for XRestackWindows
+    vector<Window> order;
+    order.reserve(layerOf_.size());
+
+    for (const auto& layer : layers_){
+        for (Window frame : layer){
+            collect(frame, order);
+        }
+    }
+    ::std::reverse(order.begin(), order.end());
+
+    if (order == order_) return;
+
+    // 2. XRestackWindows leaves the first window where it is,
+    //    so it is raised separately only when the top frame changed
+    if (!order.empty() && (order_.empty() || order_.front() != order.front())){
+        x_->RaiseWindow(order.front());
+    }
+
+    if (order.size() > 1){
+        x_->RestackWindows(order.data(), order.size());
+    }
+
+    LOG(INFO) << "Restacked " << order.size() << " frames";
+    order_.swap(order);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "backend.hpp"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Layers frames are stacked in, bottom to top.
+// Transient frames are kept directly above the frame they belong to.
+enum class StackLayer{
+    Normal,
+    OnTop,
+    Fullscreen,
+    Transient
+};
+
+class StackingManager{
+    private:
+      XBackend* x_;
+
+      // Frames of each layer, bottom to top (Transient is unused here, see transients_)
+      ::std::list<Window> layers_[3];
+      ::std::unordered_map<Window, StackLayer> layerOf_;
+      ::std::unordered_map<Window, Window> parentOf_; // transient frame -> parent frame
+      ::std::unordered_map<Window, ::std::vector<Window>> transients_; // parent -> transients, bottom to top
+
+      ::std::vector<Window> order_;   // order built by the last Flush(), top to bottom
+      bool dirty_;
+
+      void detach(Window frame);
+      void collect(Window frame, ::std::vector<Window>& out) const;
+
+    public:
+      StackingManager(XBackend* x);
+
+      void Add(Window frame, StackLayer layer, Window parent = None);
+      void Remove(Window frame);
+      void SetLayer(Window frame, StackLayer layer, Window parent = None);
+      void Raise(Window frame);
+      void Lower(Window frame);
+      StackLayer LayerOf(Window frame) const;
+
+      // Sends all changes made since the last flush to the server.
+      // Called once per event batch.
+      void Flush();
+};
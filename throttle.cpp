@@ -0,0 +1,142 @@
+#include "throttle.hpp"
+
+#include "glog/logging.h"
+#include <algorithm>
+
+using ::std::vector;
+using ::std::chrono::duration;
+using ::std::chrono::seconds;
+
+// Each client may send BUCKET_RATE requests per second, in bursts of up to BUCKET_SIZE
+const double BUCKET_RATE = 100.0;
+const double BUCKET_SIZE = 200.0;
+
+const seconds REPORT_INTERVAL(5);
+
+RequestThrottle::RequestThrottle(XID resourceMask)
+    : resourceMask_(resourceMask),
+      lastReport_()
+{}
+
+XID RequestThrottle::ClientOf(Window w) const{
+    return w & ~resourceMask_;
+}
+
+RequestThrottle::Client& RequestThrottle::charge(Window w, Clock::time_point now){
+    auto itr = clients_.find(ClientOf(w));
+    if (itr == clients_.end()){
+        itr = clients_.insert({ ClientOf(w), Client{ BUCKET_SIZE, now, 0, 0 } }).first;
+    }
+    Client& client = itr->second;
+
+    // Refill for time passed since last request
+    const double elapsed = duration<double>(now - client.last).count();
+    client.tokens = ::std::min(BUCKET_SIZE, client.tokens + elapsed * BUCKET_RATE);
+    client.last = now;
+
+    return client;
+}
+
+bool RequestThrottle::AdmitConfigure(const XConfigureRequestEvent& e, Clock::time_point now){
+    Client& client = charge(e.window, now);
+
+    // Apply now if in budget and nothing older is still held back
+    auto itr = configures_.find(e.window);
+    if (client.tokens >= 1.0 && itr == configures_.end()){
+        client.tokens -= 1.0;
+        client.admitted++;
+        return true;
+    }
+
+    client.collapsed++;
+
+    if (itr == configures_.end()){
+        configures_.insert({ e.window, e });
+        return false;
+    }
+
+    // Merge into held request, newer values win
+    XConfigureRequestEvent& held = itr->second;
+    if (e.value_mask & CWX) held.x = e.x;
+    if (e.value_mask & CWY) held.y = e.y;
+    if (e.value_mask & CWWidth) held.width = e.width;
+    if (e.value_mask & CWHeight) held.height = e.height;
+    if (e.value_mask & CWBorderWidth) held.border_width = e.border_width;
+    if (e.value_mask & CWSibling) held.above = e.above;
+    if (e.value_mask & CWStackMode) held.detail = e.detail;
+    held.value_mask |= e.value_mask;
+
+    return false;
+}
+
+bool RequestThrottle::AdmitMap(const XMapRequestEvent& e, Clock::time_point now){
+    Client& client = charge(e.window, now);
+
+    if (client.tokens >= 1.0){
+        client.tokens -= 1.0;
+        client.admitted++;
+        return true;
+    }
+
+    client.collapsed++;
+
+    const bool held = ::std::any_of(maps_.begin(), maps_.end(),
+        [&e](const XMapRequestEvent& m){ return m.window == e.window; });
+    if (!held) maps_.push_back(e);
+
+    return false;
+}
+
+vector<XConfigureRequestEvent> RequestThrottle::TakeConfigures(){
+    vector<XConfigureRequestEvent> configures;
+    configures.reserve(configures_.size());
+
+    for (const auto& held : configures_){
+        configures.push_back(held.second);
+    }
+    configures_.clear();
+
+    return configures;
+}
+
+vector<XMapRequestEvent> RequestThrottle::TakeMaps(){
+    vector<XMapRequestEvent> maps;
+    maps.swap(maps_);
+    return maps;
+}
+
+void RequestThrottle::Forget(Window w){
+    configures_.erase(w);
+    maps_.erase(
+        ::std::remove_if(maps_.begin(), maps_.end(),
+            [w](const XMapRequestEvent& m){ return m.window == w; }),
+        maps_.end()
+    );
+}
+
+void RequestThrottle::Report(Clock::time_point now){
+    // First interval starts at the first report
+    if (lastReport_ == Clock::time_point()) lastReport_ = now;
+    if (now - lastReport_ < REPORT_INTERVAL) return;
+    lastReport_ = now;
+
+    for (auto itr = clients_.begin(); itr != clients_.end();){
+        Client& client = itr->second;
+
+        if (client.collapsed){
+            LOG(WARNING) << "Client 0x" << ::std::hex << itr->first << ::std::dec
+                         << " over request budget: " << client.collapsed << " collapsed, "
+                         << client.admitted << " applied in last " << REPORT_INTERVAL.count() << "s";
+        }
+
+        // Forget clients that have gone quiet
+        if (!client.collapsed && !client.admitted){
+            itr = clients_.erase(itr);
+            continue;
+        }
+
+        client.admitted = 0;
+        client.collapsed = 0;
+        ++itr;
+    }
+}
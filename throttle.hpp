@@ -0,0 +1,50 @@
+#pragma once
+
+extern "C"{
+#include <X11/Xlib.h>
+}
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+// Per-client token buckets for ConfigureRequest/MapRequest.
+// Requests over a client's budget are held back and collapsed,
+// so only the latest geometry per window is applied at the end of a batch.
+// Callers pass the time in, so a replay can run on its recorded timeline.
+class RequestThrottle{
+    public:
+      typedef ::std::chrono::steady_clock Clock;
+
+    private:
+      struct Client{
+          double tokens;
+          Clock::time_point last;  // last refill
+          unsigned long admitted;  // since last report
+          unsigned long collapsed; // since last report
+      };
+
+      const XID resourceMask_; // ID bits chosen by the client, cleared to find its base
+      ::std::unordered_map<XID, Client> clients_;
+      ::std::unordered_map<Window, XConfigureRequestEvent> configures_; // held back, merged per window
+      ::std::vector<XMapRequestEvent> maps_; // held back, one per window
+      Clock::time_point lastReport_; // epoch until the first report
+
+      Client& charge(Window w, Clock::time_point now);
+
+    public:
+      explicit RequestThrottle(XID resourceMask);
+
+      XID ClientOf(Window w) const;
+
+      // Return true if the request should be applied now,
+      // otherwise it is kept until TakeConfigures()/TakeMaps()
+      bool AdmitConfigure(const XConfigureRequestEvent& e, Clock::time_point now);
+      bool AdmitMap(const XMapRequestEvent& e, Clock::time_point now);
+
+      ::std::vector<XConfigureRequestEvent> TakeConfigures();
+      ::std::vector<XMapRequestEvent> TakeMaps();
+      void Forget(Window w); // drop held requests for a destroyed window
+
+      void Report(Clock::time_point now); // logs clients over budget, at most once per interval
+};
@@ -0,0 +1,211 @@
+#include "trace.hpp"
+
+#include "glog/logging.h"
+#include <cstring>
+
+using ::std::unique_ptr;
+using ::std::string;
+using ::std::chrono::steady_clock;
+using ::std::chrono::microseconds;
+using ::std::chrono::duration_cast;
+
+static const char TRACE_MAGIC[4] = { 'F', 'L', 'T', 'R' };
+static const uint32_t TRACE_VERSION = 5;
+
+// Sanity limits on header sections, a corrupt count must not exhaust memory
+static const uint32_t MAX_TRACE_WINDOWS = 1 << 16;
+static const uint32_t MAX_TRACE_ATOMS = 1 << 10;
+
+template <typename T>
+static void put(::std::ofstream& out, T value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool get(::std::ifstream& in, T& value){
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Bytes of an XEvent worth keeping for its type
+static uint16_t eventSize(int type){
+    switch (type){
+        case KeyPress:
+        case KeyRelease:        return sizeof(XKeyEvent);
+        case ButtonPress:
+        case ButtonRelease:     return sizeof(XButtonEvent);
+        case MotionNotify:      return sizeof(XMotionEvent);
+        case FocusIn:
+        case FocusOut:          return sizeof(XFocusChangeEvent);
+        case CreateNotify:      return sizeof(XCreateWindowEvent);
+        case DestroyNotify:     return sizeof(XDestroyWindowEvent);
+        case UnmapNotify:       return sizeof(XUnmapEvent);
+        case MapNotify:         return sizeof(XMapEvent);
+        case MapRequest:        return sizeof(XMapRequestEvent);
+        case ReparentNotify:    return sizeof(XReparentEvent);
+        case ConfigureNotify:   return sizeof(XConfigureEvent);
+        case ConfigureRequest:  return sizeof(XConfigureRequestEvent);
+        default:                return sizeof(XEvent);
+    }
+}
+
+TraceWriter::TraceWriter(const string& path)
+    : out_(path, ::std::ios::binary | ::std::ios::trunc),
+      last_(steady_clock::now())
+{}
+
+unique_ptr<TraceWriter> TraceWriter::Open(const string& path){
+    unique_ptr<TraceWriter> writer(new TraceWriter(path));
+
+    if (!writer->out_){
+        LOG(ERROR) << "Failed to open trace file " << path;
+        return nullptr;
+    }
+
+    LOG(INFO) << "Recording events to " << path;
+    return writer;
+}
+
+void TraceWriter::WriteHeader(const TraceHeader& header){
+    out_.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    put<uint32_t>(out_, TRACE_VERSION);
+    put<uint32_t>(out_, header.root);
+    put<uint32_t>(out_, header.resourceMask);
+
+    put<uint32_t>(out_, header.windows.size());
+    for (const TraceWindow& w : header.windows){
+        put<uint32_t>(out_, w.window);
+        put<int32_t>(out_, w.x);
+        put<int32_t>(out_, w.y);
+        put<uint32_t>(out_, w.width);
+        put<uint32_t>(out_, w.height);
+    }
+
+    put<uint32_t>(out_, header.atoms.size());
+    for (const TraceAtom& a : header.atoms){
+        put<uint32_t>(out_, a.atom);
+        put<uint16_t>(out_, a.name.size());
+        out_.write(a.name.data(), a.name.size());
+    }
+
+    // Delays count from here
+    last_ = steady_clock::now();
+}
+
+void TraceWriter::writeRecord(const void* data, uint16_t size){
+    const steady_clock::time_point now = steady_clock::now();
+    uint64_t delay = duration_cast<microseconds>(now - last_).count();
+    last_ = now;
+
+    // Delay as a varint, 7 bits per byte, low bits first
+    while (delay >= 0x80){
+        out_.put(static_cast<char>((delay & 0x7f) | 0x80));
+        delay >>= 7;
+    }
+    out_.put(static_cast<char>(delay));
+
+    out_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out_.write(static_cast<const char*>(data), size);
+}
+
+void TraceWriter::Write(const XEvent& e){
+    // Extension events are not recorded, their layout is not ours to know
+    if (e.type < KeyPress || e.type >= LASTEvent) return;
+
+    XEvent copy = e;
+    copy.xany.display = nullptr; // meaningless outside this process
+
+    writeRecord(&copy, eventSize(e.type));
+}
+
+void TraceWriter::EndBatch(){
+    writeRecord(nullptr, 0);
+    out_.flush();
+}
+
+TraceReader::TraceReader(const string& path)
+    : in_(path, ::std::ios::binary),
+      header_{ None, 0, {}, {} }
+{}
+
+unique_ptr<TraceReader> TraceReader::Open(const string& path){
+    unique_ptr<TraceReader> reader(new TraceReader(path));
+
+    if (!reader->readHeader()){
+        LOG(ERROR) << "Not a flotise trace: " << path;
+        return nullptr;
+    }
+
+    return reader;
+}
+
+bool TraceReader::readHeader(){
+    char magic[sizeof(TRACE_MAGIC)];
+    uint32_t version, root_id, mask, count;
+    in_.read(magic, sizeof(magic));
+
+    if (!in_ || memcmp(magic, TRACE_MAGIC, sizeof(magic)) ||
+        !get(in_, version) || version != TRACE_VERSION ||
+        !get(in_, root_id) || !get(in_, mask) ||
+        !get(in_, count) || count > MAX_TRACE_WINDOWS){
+        return false;
+    }
+    header_.root = root_id;
+    header_.resourceMask = mask;
+
+    for (uint32_t i = 0; i < count; i++){
+        uint32_t id, width, height;
+        int32_t x, y;
+        if (!get(in_, id) || !get(in_, x) || !get(in_, y) || !get(in_, width) || !get(in_, height)){
+            return false;
+        }
+        header_.windows.push_back(TraceWindow{ id, x, y, width, height });
+    }
+
+    if (!get(in_, count) || count > MAX_TRACE_ATOMS) return false;
+
+    for (uint32_t i = 0; i < count; i++){
+        uint32_t id;
+        uint16_t length;
+        if (!get(in_, id) || !get(in_, length)) return false;
+
+        string name(length, '\0');
+        if (!in_.read(&name[0], length)) return false;
+        header_.atoms.push_back(TraceAtom{ id, name });
+    }
+
+    return true;
+}
+
+bool TraceReader::Next(TraceRecord& record){
+    uint64_t delay = 0;
+    for (int shift = 0; ; shift += 7){
+        const int byte = in_.get();
+        if (byte == EOF || shift > 63) return false;
+
+        delay |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+
+    uint16_t size;
+    in_.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!in_) return false;
+
+    record.delay = microseconds(delay);
+    record.endOfBatch = (size == 0);
+    memset(&record.event, 0, sizeof(record.event));
+
+    if (size > sizeof(record.event)){
+        LOG(ERROR) << "Corrupt trace record of " << size << " bytes";
+        return false;
+    }
+    in_.read(reinterpret_cast<char*>(&record.event), size);
+    if (!in_) return false;
+
+    // Only core events are recorded, anything else is not a trace of ours
+    if (!record.endOfBatch && (record.event.type < KeyPress || record.event.type >= LASTEvent)){
+        LOG(ERROR) << "Corrupt trace record of event type " << record.event.type;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+extern "C"{
+#include <X11/Xlib.h>
+}
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary trace of the events seen by WindowManager::Run(), in host byte order.
+//
+//   header: "FLTR", u32 version, u32 root window, u32 resource mask,
+//           u32 window count, per window: u32 id, i32 x, i32 y, u32 width, u32 height,
+//           u32 atom count, per atom: u32 id, u16 name length, name
+//   record: varint microseconds since previous record, u16 size, size bytes of event
+//
+// The header windows are those framed by WindowManager::Manage(), which a replay
+// has to recreate before its first event. The atoms are those the window manager
+// compares events against, so a replay can map them to its own server's ids.
+// The resource mask tells which recorded windows belong to the same client.
+// Events are cut to the struct of their type with the display pointer cleared.
+// A record of size 0 marks the end of an event batch.
+
+struct TraceWindow{
+    Window window;
+    int x, y;
+    unsigned int width, height;
+};
+
+struct TraceAtom{
+    Atom atom;
+    ::std::string name;
+};
+
+struct TraceHeader{
+    Window root;
+    XID resourceMask; // of the recording connection
+    ::std::vector<TraceWindow> windows; // already mapped when recording started
+    ::std::vector<TraceAtom> atoms;
+};
+
+struct TraceRecord{
+    ::std::chrono::microseconds delay; // since previous record
+    bool endOfBatch;
+    XEvent event;
+};
+
+class TraceWriter{
+    private:
+      TraceWriter(const ::std::string& path);
+      ::std::ofstream out_;
+      ::std::chrono::steady_clock::time_point last_;
+
+      void writeRecord(const void* data, uint16_t size);
+
+    public:
+      static ::std::unique_ptr<TraceWriter> Open(const ::std::string& path); //Factory Method
+      void WriteHeader(const TraceHeader& header); // once, before any event
+      void Write(const XEvent& e);
+      void EndBatch(); // also flushes the file
+};
+
+class TraceReader{
+    private:
+      TraceReader(const ::std::string& path);
+      ::std::ifstream in_;
+      TraceHeader header_;
+
+      bool readHeader();
+
+    public:
+      static ::std::unique_ptr<TraceReader> Open(const ::std::string& path); //Factory Method
+      const TraceHeader& Header() const { return header_; } // recorded display
+      bool Next(TraceRecord& record); // false at end of trace
+};
@@ -1,4 +1,5 @@
 #include "window_manager.hpp"
+#include "xlib_backend.hpp"
 
 extern "C"{
 #include <X11/Xutil.h>
@@ -7,17 +8,24 @@ extern "C"{
 
 #include "glog/logging.h"
 #include <cstring>
+#include <cstdio>
+#include <ctime>
 #include <algorithm>
 
 using ::std::unique_ptr;
 using ::std::string;
 using ::std::max;
 using ::std::pair;
+using ::std::vector;
 
 const unsigned int BORDER_WIDTH = 3;
 const unsigned long BORDER_COLOUR = 0x9c353e;
 const unsigned long BG_COLOUR = 0x594646;
 
+// Most events handled before held back requests and stacking are applied,
+// so a flooding client cannot hold off the end of a batch
+const int MAX_BATCH_EVENTS = 64;
+
 XColor color;
 
 static const char* const X_EVENT_TYPE_NAMES[] = {
@@ -59,144 +67,268 @@ static const char* const X_EVENT_TYPE_NAMES[] = {
       "GeneralEvent",
   };
 
-bool WindowManager::wm_detected_;
+// Extension events and corrupt traces can be outside the table
+static const char* eventName(int type){
+    if (type < 0 || type >= LASTEvent) return "(unknown)";
+    return X_EVENT_TYPE_NAMES[type];
+}
 
-unique_ptr<WindowManager> WindowManager::Create(){
-    // 1. Open X display
-    Display* display = XOpenDisplay(nullptr);
+unique_ptr<WindowManager> WindowManager::Create(const char* display_name){
+    // 1. Open X display (nullptr = $DISPLAY)
+    unique_ptr<XlibBackend> x = XlibBackend::Open(display_name);
 
     // error handling for opening display
-    if (display == nullptr){
-        LOG(ERROR) << "Failed to open X display" << XDisplayName(nullptr);
+    if (!x){
         return nullptr;
     }
 
     // 2. Construct WM instance
-    return unique_ptr<WindowManager> (new WindowManager(display));
+    return Create(::std::move(x));
+}
+
+unique_ptr<WindowManager> WindowManager::Create(unique_ptr<XBackend> x){
+    return unique_ptr<WindowManager> (new WindowManager(::std::move(x)));
 }
 
-WindowManager::WindowManager(Display* display)
-    : display_(CHECK_NOTNULL(display)),
-      root_(DefaultRootWindow(display_)),
-      WM_DELETE_WINDOW(XInternAtom(display_, "WM_DELETE_WINDOW", false)),
-      WM_PROTOCOLS(XInternAtom(display_, "WM_PROTOCOLS", false))
+WindowManager::WindowManager(unique_ptr<XBackend> x)
+    : x_(::std::move(x)),
+      root_(CHECK_NOTNULL(x_.get())->Root()),
+      stacking_(x_.get()),
+      frames_(x_.get(), root_, BORDER_WIDTH, BORDER_COLOUR, BG_COLOUR),
+      throttle_(x_->ResourceMask()),
+      clock_(RequestThrottle::Clock::now),
+      managed_(false),
+      WM_DELETE_WINDOW(x_->InternAtom("WM_DELETE_WINDOW")),
+      WM_PROTOCOLS(x_->InternAtom("WM_PROTOCOLS")),
+      NET_WM_STATE(x_->InternAtom("_NET_WM_STATE")),
+      NET_WM_STATE_ABOVE(x_->InternAtom("_NET_WM_STATE_ABOVE")),
+      NET_WM_STATE_FULLSCREEN(x_->InternAtom("_NET_WM_STATE_FULLSCREEN"))
 {}
 
-WindowManager::~WindowManager(){
-    XCloseDisplay(display_);
-}
+WindowManager::~WindowManager(){}
 
 void WindowManager::Run() { 
-    // 1. Init
-    //  - select events on root window, quit if another WM present
+    if (!Manage()) return;
 
-    wm_detected_ = false;
-    XSetErrorHandler(&WindowManager::OnWMDetected); // defer to OnWMDetected if error encountered
-    
-    XSelectInput (
-        display_,
-        root_,
-        SubstructureRedirectMask | SubstructureNotifyMask | FocusChangeMask
-    );
+    // Event Loop
+    for (;;){
+        // Next event, stop if the display went away
+        XEvent e;
+        if (!x_->NextEvent(&e)){
+            LOG(ERROR) << "Lost connection to " << x_->DisplayName();
+            return;
+        }
+        HandleEvent(e);
 
-    XSetInputFocus(display_, PointerRoot, NULL, CurrentTime);
+        // Take already queued events as one batch...
+        for (int handled = 1; handled < MAX_BATCH_EVENTS && x_->Pending() && x_->NextEvent(&e); handled++){
+            HandleEvent(e);
+        }
 
-    XSync(display_, false);
+        // ...then apply what it held back in one go
+        EndBatch();
+    }
+}
 
-    if (wm_detected_){
-        LOG(ERROR) << "Another window manager is already running" << XDisplayString(display_);
-        return;
+bool WindowManager::Manage(){
+    // Init
+    //  - select events on root window, quit if another WM present
+    if (!x_->SelectRootInput(SubstructureRedirectMask | SubstructureNotifyMask | FocusChangeMask)){
+        LOG(ERROR) << "Another window manager is already running on " << x_->DisplayName();
+        return false;
     }
 
-    //  - set error handler
-    XSetErrorHandler(&WindowManager::OnXError);
+    x_->SetInputFocus(PointerRoot, RevertToNone);
+
+    //  - create spare frames up front
+    frames_.Fill();
 
     //  - prevent changes to existing windows during framing
-    XGrabServer(display_);
+    x_->GrabServer();
 
     //  - frame existing windows
-    Window returned_root, returned_parent;
-    Window* top_level_windows;
-    unsigned int num_top_level_windows;
+    vector<Window> top_level_windows;
+    if (!x_->QueryTree(root_, top_level_windows)){
+        LOG(ERROR) << "Cannot list existing windows on " << x_->DisplayName();
+        x_->UngrabServer();
+        return false;
+    }
 
-    CHECK(XQueryTree(
-        display_,
-        root_,
-        &returned_root,
-        &returned_parent,
-        &top_level_windows,
-        &num_top_level_windows
-    ));
-    CHECK_EQ(returned_root, root_);
-
-    for (unsigned int i = 0; i < num_top_level_windows; i++){
-        Frame(top_level_windows[i], true /*was created before flotise*/);
+    for (Window w : top_level_windows){
+        Frame(w, true /*was created before flotise*/);
     }
+    stacking_.Flush();
 
     //  - allow changes again
-    XFree(top_level_windows);
-    XUngrabServer(display_);
+    x_->UngrabServer();
 
-    // 2. Event Loop
-    for (;;){
-        // Next event
-        XEvent e;
-        XNextEvent(display_, &e);
-        LOG(INFO) << "Received event: " << X_EVENT_TYPE_NAMES[e.type];
-
-        //Handle event depending on type
-        switch (e.type){
-            case CreateNotify:
-                OnCreateNotify(e.xcreatewindow);
-                break;
-            case ConfigureRequest:
-                OnConfigureRequest(e.xconfigurerequest);
-                break;
-            case MapRequest:
-                OnMapRequest(e.xmaprequest);
-                break;
-            case ConfigureNotify:
-                OnConfigureNotify(e.xconfigure);
-                break;
-            case UnmapNotify:
-                OnUnmapNotify(e.xunmap);
-                break;
-            case DestroyNotify:
-                OnDestroyNotify(e.xdestroywindow);
-                break;
-            case ButtonPress:
-                OnButtonPress(e.xbutton);
-                break;
-            case KeyPress:
-                OnKeyPress(e.xkey);
-                break;
-            case ButtonRelease:
-                OnButtonRelease(e.xbutton);
-                break; 
-            case KeyRelease:
-                OnKeyRelease(e.xkey);
-                break;
-            case MotionNotify:
-                OnMotionNotify(e.xmotion);
-                break;
-            case FocusIn:
-                OnFocusIn(e.xfocus);
-                break;
-            case FocusOut:
-                OnFocusOut(e.xfocus);
-                break;
-            default:
-                LOG(WARNING) << "Unhandled Event" << X_EVENT_TYPE_NAMES[e.type];
-        }
+    //  - a replay has to start from these windows
+    managed_ = true;
+    if (trace_) writeTraceHeader();
+
+    return true;
+}
+
+void WindowManager::EndBatch(){
+    timespec start = {};
+    unsigned long first_request = 0;
+    if (!profile_.empty()){
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        first_request = x_->NextRequestSerial();
     }
+
+    // 1. Requests over their client's budget, latest state per window
+    for (const XMapRequestEvent& e : throttle_.TakeMaps()){
+        if (!clients_.count(e.window)) applyMap(e);
+    }
+
+    for (const XConfigureRequestEvent& e : throttle_.TakeConfigures()){
+        applyConfigure(e);
+    }
+
+    // 2. Stacking changes as a single restack
+    stacking_.Flush();
+
+    throttle_.Report(clock_());
+
+    if (trace_) trace_->EndBatch();
+    if (!profile_.empty()) addProfile(0, start, first_request);
+}
+
+void WindowManager::HandleEvent(const XEvent& e){
+    LOG(INFO) << "Received event: " << eventName(e.type);
+
+    if (trace_) trace_->Write(e);
+
+    timespec start = {};
+    unsigned long first_request = 0;
+    if (!profile_.empty()){
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        first_request = x_->NextRequestSerial();
+    }
+
+    //Handle event depending on type
+    switch (e.type){
+        case CreateNotify:
+            OnCreateNotify(e.xcreatewindow);
+            break;
+        case ConfigureRequest:
+            OnConfigureRequest(e.xconfigurerequest);
+            break;
+        case MapRequest:
+            OnMapRequest(e.xmaprequest);
+            break;
+        case ConfigureNotify:
+            OnConfigureNotify(e.xconfigure);
+            break;
+        case UnmapNotify:
+            OnUnmapNotify(e.xunmap);
+            break;
+        case DestroyNotify:
+            OnDestroyNotify(e.xdestroywindow);
+            break;
+        case ButtonPress:
+            OnButtonPress(e.xbutton);
+            break;
+        case KeyPress:
+            OnKeyPress(e.xkey);
+            break;
+        case ButtonRelease:
+            OnButtonRelease(e.xbutton);
+            break; 
+        case KeyRelease:
+            OnKeyRelease(e.xkey);
+            break;
+        case MotionNotify:
+            OnMotionNotify(e.xmotion);
+            break;
+        case FocusIn:
+            OnFocusIn(e.xfocus);
+            break;
+        case FocusOut:
+            OnFocusOut(e.xfocus);
+            break;
+        case ClientMessage:
+            OnClientMessage(e.xclient);
+            break;
+        default:
+            LOG(WARNING) << "Unhandled Event" << eventName(e.type);
+    }
+
+    if (!profile_.empty()) addProfile(e.type, start, first_request);
+}
+
+bool WindowManager::RecordTo(const string& path){
+    trace_ = TraceWriter::Open(path);
+    if (!trace_) return false;
+
+    // Otherwise written once Manage() has framed the existing windows
+    if (managed_) writeTraceHeader();
+    return true;
+}
+
+void WindowManager::writeTraceHeader(){
+    TraceHeader header = { root_, x_->ResourceMask(), {}, {} };
+
+    for (const auto& client : clients_){
+        int x, y;
+        unsigned int width, height;
+        if (!x_->GetGeometry(client.second, &x, &y, &width, &height)) continue;
+
+        header.windows.push_back(TraceWindow{ client.first, x, y, width, height });
+    }
+
+    // Atoms are numbered per server, a replay looks them up by name
+    header.atoms = {
+        { WM_DELETE_WINDOW, "WM_DELETE_WINDOW" },
+        { WM_PROTOCOLS, "WM_PROTOCOLS" },
+        { NET_WM_STATE, "_NET_WM_STATE" },
+        { NET_WM_STATE_ABOVE, "_NET_WM_STATE_ABOVE" },
+        { NET_WM_STATE_FULLSCREEN, "_NET_WM_STATE_FULLSCREEN" },
+    };
+
+    trace_->WriteHeader(header);
+}
+
+void WindowManager::SetClock(::std::function<RequestThrottle::Clock::time_point()> clock){
+    clock_ = ::std::move(clock);
+}
+
+void WindowManager::EnableProfiling(){
+    profile_.assign(LASTEvent, HandlerProfile{ 0, 0.0, 0 });
+}
+
+void WindowManager::addProfile(int type, const timespec& start, unsigned long first_request){
+    timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+
+    if (type < 0 || type >= static_cast<int>(profile_.size())) return;
+
+    HandlerProfile& p = profile_[type];
+    p.calls++;
+    p.cpuSeconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    p.requests += x_->NextRequestSerial() - first_request;
 }
 
-int WindowManager::OnWMDetected(Display* display, XErrorEvent* e){
-    // Check error code - should be BadAccess
-    CHECK_EQ(static_cast<int>(e->error_code), BadAccess);
-    // Set flag then return
-    wm_detected_ = true;
-    return 0;
+void WindowManager::WriteProfile(::std::ostream& out) const{
+    char line[128];
+    snprintf(line, sizeof(line), "%-18s %10s %12s %10s %12s %10s\n",
+             "handler", "calls", "cpu ms", "us/call", "X requests", "req/call");
+    out << line;
+
+    for (size_t type = 0; type < profile_.size(); type++){
+        const HandlerProfile& p = profile_[type];
+        if (!p.calls) continue;
+
+        snprintf(line, sizeof(line), "%-18s %10lu %12.3f %10.2f %12lu %10.2f\n",
+                 type ? eventName(type) : "(end of batch)",
+                 p.calls,
+                 p.cpuSeconds * 1e3,
+                 p.cpuSeconds * 1e6 / p.calls,
+                 p.requests,
+                 double(p.requests) / p.calls);
+        out << line;
+    }
 }
 
 void WindowManager::OnCreateNotify(const XCreateWindowEvent& e){}
@@ -204,6 +336,10 @@ void WindowManager::OnCreateNotify(const XCreateWindowEvent& e){}
 void WindowManager::OnConfigureNotify(const XConfigureEvent& e){}
 
 void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e){
+    if (throttle_.AdmitConfigure(e, clock_())) applyConfigure(e);
+}
+
+void WindowManager::applyConfigure(const XConfigureRequestEvent& e){
     XWindowChanges changes;
     // 1. Changes from e -> changes object
     changes.x = e.x;
@@ -218,73 +354,83 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e){
 
     if (clients_.count(e.window)){ //apply changes to window frame...
         const Window frame = clients_[e.window];
-        XConfigureWindow(display_, frame, e.value_mask, &changes);
-        LOG(INFO) << "Resize [" << frame << "] to " << e.width << "x" << e.height;
+
+        // Frame stacking goes through the stacking manager
+        if (e.value_mask & CWStackMode){
+            if (e.detail == Above) stacking_.Raise(frame);
+            else if (e.detail == Below) stacking_.Lower(frame);
+        }
+
+        x_->ConfigureWindow(frame, e.value_mask & ~(CWSibling | CWStackMode), &changes);
     }
 
-    XConfigureWindow(display_, e.window, e.value_mask, &changes); //...then to window
+    x_->ConfigureWindow(e.window, e.value_mask, &changes); //...then to window
 
     // 3. Log event for debugging
     LOG(INFO) << "Resize " << e.window << " to " << e.width << "x" << e.height;
 }
 
 void WindowManager::OnMapRequest(const XMapRequestEvent& e){
+    if (throttle_.AdmitMap(e, clock_())) applyMap(e);
+}
+
+void WindowManager::applyMap(const XMapRequestEvent& e){
     Window focused;
     int revertTo;
 
-    XGetInputFocus(display_, &focused, &revertTo);
+    x_->GetInputFocus(&focused, &revertTo);
+
+    // Focus may have reverted to a frame or elsewhere, which is not a client to join
+    auto itr = clients_.find(focused);
 
-    if (focused == PointerRoot){
+    if (focused == PointerRoot || itr == clients_.end()){
         LOG(INFO) << "Create new container for " << e.window;
         Frame(e.window, false);
-        XMapWindow(display_, e.window);
+        x_->MapWindow(e.window);
     }
 
     else{
-        
-
-        auto itr = clients_.find(focused);
         Window frame = itr->second;
         clients_.insert({ e.window, frame });
         LOG(INFO) << "Add " << e.window << " to existing container " << frame;
+
+        // An on-top or fullscreen client lifts the frame it joins
+        Window parent_frame = None;
+        const StackLayer layer = layerFor(e.window, &parent_frame);
+        if ((layer == StackLayer::OnTop || layer == StackLayer::Fullscreen) &&
+            stacking_.LayerOf(frame) == StackLayer::Normal){
+            stacking_.SetLayer(frame, layer);
+        }
         XWindowAttributes attributes;
 
-        XReparentWindow(
-            display_,
+        x_->ReparentWindow(
             e.window,
             frame,
             0, 0
         );
 
-        XGrabButton( // Move window (alt + lclick & drag)
-            display_,
+        x_->GrabButton( // Move window (alt + lclick & drag)
             Button1,
             Mod1Mask,
             e.window,
             false,
             ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
             GrabModeAsync,
-            GrabModeAsync,
-            None,
-            None
+            GrabModeAsync
         );
 
-        XGrabButton( // Resize window (alt + rclick & drag)
-            display_,
+        x_->GrabButton( // Resize window (alt + rclick & drag)
             Button3,
             Mod1Mask,
             e.window,
             false,
             ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
             GrabModeAsync,
-            GrabModeAsync,
-            None,
-            None
+            GrabModeAsync
         );
 
-        XGrabKey( // Kill window (alt+f4)
-            display_,
-            XKeysymToKeycode(display_, XK_F4),
+        x_->GrabKey( // Kill window (alt+f4)
+            x_->KeysymToKeycode(XK_F4),
             Mod1Mask,
             e.window,
             false,
@@ -292,9 +438,8 @@ void WindowManager::OnMapRequest(const XMapRequestEvent& e){
             GrabModeAsync
         );
 
-        XGrabKey( // Switch window (alt+tab)
-            display_,
-            XKeysymToKeycode(display_, XK_Tab),
+        x_->GrabKey( // Switch window (alt+tab)
+            x_->KeysymToKeycode(XK_Tab),
             Mod1Mask,
             e.window,
             false,
@@ -302,9 +447,8 @@ void WindowManager::OnMapRequest(const XMapRequestEvent& e){
             GrabModeAsync
         );
 
-        XGrabKey( // Escape to new container (alt+esc)
-            display_,
-            XKeysymToKeycode(display_, XK_Escape),
+        x_->GrabKey( // Escape to new container (alt+esc)
+            x_->KeysymToKeycode(XK_Escape),
             Mod1Mask,
             e.window,
             false,
@@ -312,38 +456,36 @@ void WindowManager::OnMapRequest(const XMapRequestEvent& e){
             GrabModeAsync
         );
 
-        XMapWindow(display_, e.window);
+        x_->MapWindow(e.window);
 
         buildFrame(frame);
     }
 }
 
 void WindowManager::buildFrame(Window frame){
+    // Queries fail if the frame or the connection is gone
     XWindowAttributes attr;
-    CHECK(XGetWindowAttributes(display_, frame, &attr));
+    if (!x_->GetWindowAttributes(frame, &attr)) return;
 
     int width = attr.width;
     int height = attr.height;
     int x = 0;
     int y = 0;
 
-    Window parent, root, *children;
-    unsigned int childrenSize;
-
-    CHECK(XQueryTree(display_, frame, &parent, &root, &children, &childrenSize));
+    vector<Window> children;
+    if (!x_->QueryTree(frame, children) || children.empty()) return;
+    const unsigned int childrenSize = children.size();
 
     for (int i = 0; i < childrenSize-1; i++){
         if (i%2) width *= 0.5;
         else height *= 0.5;
 
-        XResizeWindow(
-            display_, 
+        x_->ResizeWindow(
             children[i], 
             width, height
         );
 
-        XMoveWindow(
-            display_,
+        x_->MoveWindow(
             children[i],
             x, y
         );
@@ -352,14 +494,12 @@ void WindowManager::buildFrame(Window frame){
         else y += height;
     }
 
-    XResizeWindow(
-        display_,
+    x_->ResizeWindow(
         children[childrenSize-1],
         width, height
     );
 
-    XMoveWindow(
-        display_,
+    x_->MoveWindow(
         children[childrenSize-1],
         x, y
     );
@@ -388,34 +528,25 @@ void WindowManager::OnUnmapNotify(const XUnmapEvent& e){
         return;
     }
 
-    unsigned int numchildren;
     auto itr = clients_.find(e.window);
     Window frame = itr->second; 
 
-    XReparentWindow(
-        display_,
+    x_->ReparentWindow(
         e.window,
         root_,
         0, 0
     );
 
-    XRemoveFromSaveSet(display_, e.window);
+    x_->RemoveFromSaveSet(e.window);
     clients_.erase(e.window);
-    Window root, parent, *children;
-    
-    XQueryTree(
-        display_,
-        frame,
-        &root,
-        &parent,
-        &children,
-        &numchildren
-    );
-
-    if (children == 0){
-        LOG(INFO) << "Destroying empty frame " << frame;
-        XDestroyWindow(display_, frame);
-        XSetInputFocus(display_, PointerRoot, PointerRoot, CurrentTime);
+    vector<Window> children;
+    x_->QueryTree(frame, children);
+
+    if (children.empty()){
+        LOG(INFO) << "Releasing empty frame " << frame;
+        stacking_.Remove(frame);
+        frames_.Release(frame);
+        x_->SetInputFocus(PointerRoot, PointerRoot);
     }
 
     else{
@@ -425,11 +556,17 @@ void WindowManager::OnUnmapNotify(const XUnmapEvent& e){
 
 void WindowManager::Frame(Window w, bool created_before_wm){ //Draws window decorations
 
-    CHECK(!clients_.count(w));
+    if (clients_.count(w)){
+        LOG(WARNING) << "Window " << w << " is already framed";
+        return;
+    }
 
     // Get attrs on window to frame (+ error checking)
     XWindowAttributes attributes;
-    CHECK(XGetWindowAttributes(display_, w, &attributes));
+    if (!x_->GetWindowAttributes(w, &attributes)){
+        LOG(WARNING) << "Cannot frame window " << w << ", it is gone";
+        return;
+    }
 
     // if framing pre-existing window during init
     // have to check that it is visible and doesnt set override_redirect
@@ -440,71 +577,56 @@ void WindowManager::Frame(Window w, bool created_before_wm){ //Draws window deco
         }
     }
 
-    // Create frame
-    const Window frame = XCreateSimpleWindow (
-        display_,
-        root_,
+    // Work out stacking layer before the client is saved
+    Window parent_frame = None;
+    const StackLayer layer = layerFor(w, &parent_frame);
+
+    // Take frame from the pool
+    const Window frame = frames_.Acquire(
         attributes.x,
         attributes.y,
         attributes.width,
-        attributes.height,
-        BORDER_WIDTH,
-        BORDER_COLOUR,
-        BG_COLOUR
-    );
-
-    // Request that X report events associated with the frame
-    XSelectInput(
-        display_,
-        frame,
-        SubstructureRedirectMask | SubstructureNotifyMask | FocusChangeMask
+        attributes.height
     );
 
     // Restore client if crash
-    XAddToSaveSet(display_, w);
+    x_->AddToSaveSet(w);
 
-    XReparentWindow(
-        display_,
+    x_->ReparentWindow(
         w,
         frame,
         0, 0
     );
 
     // map frame to display
-    XMapWindow(display_, frame);
+    x_->MapWindow(frame);
 
     // Save handle
     clients_.insert({ w, frame });
+    stacking_.Add(frame, layer, parent_frame);
     
-    XGrabButton( // Move window (alt + lclick & drag)
-        display_,
+    x_->GrabButton( // Move window (alt + lclick & drag)
         Button1,
         Mod1Mask,
         w,
         false,
         ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
         GrabModeAsync,
-        GrabModeAsync,
-        None,
-        None
+        GrabModeAsync
     );
 
-    XGrabButton( // Resize window (alt + rclick & drag)
-        display_,
+    x_->GrabButton( // Resize window (alt + rclick & drag)
         Button3,
         Mod1Mask,
         w,
         false,
         ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
         GrabModeAsync,
-        GrabModeAsync,
-        None,
-        None
+        GrabModeAsync
     );
 
-    XGrabKey( // Kill window (alt+f4)
-        display_,
-        XKeysymToKeycode(display_, XK_F4),
+    x_->GrabKey( // Kill window (alt+f4)
+        x_->KeysymToKeycode(XK_F4),
         Mod1Mask,
         w,
         false,
@@ -512,9 +634,8 @@ void WindowManager::Frame(Window w, bool created_before_wm){ //Draws window deco
         GrabModeAsync
     );
 
-    XGrabKey( // Switch window (alt+tab)
-        display_,
-        XKeysymToKeycode(display_, XK_Tab),
+    x_->GrabKey( // Switch window (alt+tab)
+        x_->KeysymToKeycode(XK_Tab),
         Mod1Mask,
         w,
         false,
@@ -522,9 +643,8 @@ void WindowManager::Frame(Window w, bool created_before_wm){ //Draws window deco
         GrabModeAsync
     );
 
-    XGrabKey( // Unfocus current window
-        display_,
-        XKeysymToKeycode(display_, XK_Escape),
+    x_->GrabKey( // Unfocus current window
+        x_->KeysymToKeycode(XK_Escape),
         Mod1Mask,
         w,
         false,
@@ -535,52 +655,63 @@ void WindowManager::Frame(Window w, bool created_before_wm){ //Draws window deco
     LOG(INFO) << "Framed window " << w << " [" << frame << "]";
 }
 
-void WindowManager::Unframe(Window w){
-    CHECK(clients_.count(w));
+StackLayer WindowManager::layerFor(Window w, Window* parent_frame){
+    // Transients stack above the frame of the window they belong to
+    Window transient_for;
+    if (x_->GetTransientForHint(w, &transient_for) && clients_.count(transient_for)){
+        *parent_frame = clients_[transient_for];
+        return StackLayer::Transient;
+    }
+
+    // Otherwise go by _NET_WM_STATE set before mapping
+    vector<Atom> states;
+    StackLayer layer = StackLayer::Normal;
 
+    x_->GetAtomProperty(w, NET_WM_STATE, states);
+    for (Atom state : states){
+        if (state == NET_WM_STATE_FULLSCREEN) layer = StackLayer::Fullscreen;
+        else if (state == NET_WM_STATE_ABOVE && layer == StackLayer::Normal) layer = StackLayer::OnTop;
+    }
+
+    return layer;
+}
+
+void WindowManager::Unframe(Window w){
     // Get frame
     auto itr = clients_.find(w);
+    if (itr == clients_.end()) return;
     Window frame = itr->second;
 
     // Reparent frameless client to root window
-    XReparentWindow(
-        display_,
+    x_->ReparentWindow(
         w,
         root_,
         0, 0
     );
     // Remove client from save set
-    XRemoveFromSaveSet(display_, w);
+    x_->RemoveFromSaveSet(w);
 
     clients_.erase(w);
 
-    XSetInputFocus(display_, PointerRoot, PointerRoot, CurrentTime);
+    x_->SetInputFocus(PointerRoot, PointerRoot);
 
     LOG(INFO) << "Unframed Window " << w << " [" << frame << "]";
 }
 
-void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e){}
+void WindowManager::OnDestroyNotify(const XDestroyWindowEvent& e){
+    throttle_.Forget(e.window);
+}
 
 void WindowManager::OnKeyPress(const XKeyEvent& e){
     //alt+f4 - close window
-    if ((e.state & Mod1Mask) && (e.keycode == XKeysymToKeycode(display_, XK_F4))){
-        Atom* supported_protocols;
-        int num_supported_protocols;
+    if ((e.state & Mod1Mask) && (e.keycode == x_->KeysymToKeycode(XK_F4))){
+        vector<Atom> supported_protocols;
         // Try the WM_DELETE_WINDOW protocol (preferred)
-        if (XGetWMProtocols
-            (
-                display_,
-                e.window,
-                &supported_protocols,
-                &num_supported_protocols
-            ) &&supported_protocols + 
-            (
-                ::std::find(supported_protocols,
-                            supported_protocols + num_supported_protocols,
-                            WM_DELETE_WINDOW
-                            ) !=
-                    supported_protocols + num_supported_protocols
-            )
+        if (x_->GetWMProtocols(e.window, supported_protocols) &&
+            ::std::find(supported_protocols.begin(),
+                        supported_protocols.end(),
+                        WM_DELETE_WINDOW
+                        ) != supported_protocols.end()
         ){
             LOG(INFO) << "Gracefully deleting window " << e.window;
 
@@ -594,18 +725,20 @@ void WindowManager::OnKeyPress(const XKeyEvent& e){
             msg.xclient.data.l[0] = WM_DELETE_WINDOW;
 
             // send message
-            CHECK(XSendEvent(display_, e.window, false, 0, (XEvent *)&msg));
+            if (!x_->SendEvent(e.window, false, 0, (XEvent *)&msg)){
+                LOG(WARNING) << "Cannot send WM_DELETE_WINDOW to " << e.window;
+            }
         } else { // if protocol unsupported, kill window
             LOG(INFO) << "Killing Window " << e.window;
-            XKillClient(display_, e.window);
+            x_->KillClient(e.window);
         }
     } 
     // alt+tab - cycle windows
-    else if ((e.state & Mod1Mask) && e.keycode == XKeysymToKeycode(display_, XK_Tab))
+    else if ((e.state & Mod1Mask) && e.keycode == x_->KeysymToKeycode(XK_Tab))
     {
         //Get next window
         auto i = clients_.find(e.window);
-        CHECK(i != clients_.end());
+        if (i == clients_.end()) return;
         ++i;
         if (i == clients_.end())
         {
@@ -613,41 +746,80 @@ void WindowManager::OnKeyPress(const XKeyEvent& e){
         }
 
         //Raise window
-        XRaiseWindow(display_, i->second);
-        XSetInputFocus(display_, i->first, RevertToPointerRoot, CurrentTime);
+        stacking_.Raise(i->second);
+        x_->SetInputFocus(i->first, RevertToPointerRoot);
     }
 
-    else if((e.state & Mod1Mask) && e.keycode == XKeysymToKeycode(display_, XK_Escape)){
+    else if((e.state & Mod1Mask) && e.keycode == x_->KeysymToKeycode(XK_Escape)){
         if (!(clients_.count(e.window))) return;
         Window frame = clients_[e.window];
 
         //XSetWindowBorderWidth(display_, frame, 0);
-        XSetInputFocus(display_, PointerRoot, NULL, CurrentTime);
+        x_->SetInputFocus(PointerRoot, RevertToNone);
     } 
 }
 
 void WindowManager::OnKeyRelease(const XKeyEvent& e){}
 
+void WindowManager::OnClientMessage(const XClientMessageEvent& e){
+    // _NET_WM_STATE change after mapping: l[0] action, l[1] and l[2] states
+    if (e.message_type != NET_WM_STATE || !clients_.count(e.window)) return;
+
+    const Window frame = clients_[e.window];
+    const StackLayer layer = stacking_.LayerOf(frame);
+
+    // 1. Current state from the property, keeping states we do not handle
+    vector<Atom> states;
+    x_->GetAtomProperty(e.window, NET_WM_STATE, states);
+
+    bool fullscreen = ::std::count(states.begin(), states.end(), NET_WM_STATE_FULLSCREEN);
+    bool above = ::std::count(states.begin(), states.end(), NET_WM_STATE_ABOVE);
+
+    // 2. Apply remove (0), add (1) or toggle (2)
+    for (int i = 1; i <= 2; i++){
+        const Atom state = e.data.l[i];
+        bool* flag = state == NET_WM_STATE_FULLSCREEN ? &fullscreen :
+                     state == NET_WM_STATE_ABOVE ? &above : nullptr;
+        if (!flag) continue;
+
+        if (e.data.l[0] == 0) *flag = false;
+        else if (e.data.l[0] == 1) *flag = true;
+        else if (e.data.l[0] == 2) *flag = !*flag;
+    }
+
+    // 3. Write state back, as the WM owns it once mapped
+    states.erase(::std::remove(states.begin(), states.end(), NET_WM_STATE_FULLSCREEN), states.end());
+    states.erase(::std::remove(states.begin(), states.end(), NET_WM_STATE_ABOVE), states.end());
+    if (fullscreen) states.push_back(NET_WM_STATE_FULLSCREEN);
+    if (above) states.push_back(NET_WM_STATE_ABOVE);
+    x_->ChangeAtomProperty(e.window, NET_WM_STATE, states);
+
+    // 4. Restack frame, transients stay with their parent
+    if (layer == StackLayer::Transient) return;
+
+    const StackLayer new_layer = fullscreen ? StackLayer::Fullscreen :
+                                 above ? StackLayer::OnTop : StackLayer::Normal;
+    if (new_layer != layer){
+        LOG(INFO) << "Move frame " << frame << " to layer " << static_cast<int>(new_layer);
+        stacking_.SetLayer(frame, new_layer);
+    }
+}
+
 void WindowManager::OnButtonPress(const XButtonEvent& e){
-    CHECK(clients_.count(e.window));
+    if (!clients_.count(e.window)) return;
     const Window frame = clients_[e.window];
 
     dragStartX_ = e.x_root; //
     dragStartY_ = e.y_root; // save cursor's starting position
 
-    Window returnedroot;
     int x,y;
-    unsigned width, height, borderwidth, depth;
+    unsigned width, height;
 
-    CHECK(XGetGeometry(
-        display_,
+    if (!x_->GetGeometry(
         frame,
-        &returnedroot,
         &x, &y,
-        &width, &height,
-        &borderwidth,
-        &depth
-    ));
+        &width, &height
+    )) return;
 
     dragStartFrameX_ = x;
     dragStartFrameY_ = y;
@@ -655,16 +827,16 @@ void WindowManager::OnButtonPress(const XButtonEvent& e){
     dragStartFrameWidth_ = width;
     dragStartFrameHeight_ = height;
 
-    XRaiseWindow(display_, frame);
-    XSetInputFocus(display_, e.window, RevertToParent, CurrentTime);
+    stacking_.Raise(frame);
+    x_->SetInputFocus(e.window, RevertToParent);
 }
 
 void WindowManager::OnButtonRelease(const XButtonEvent& e){}
 
 void WindowManager::OnMotionNotify(const XMotionEvent& e){
-    CHECK(clients_.count(e.window));
-
     const auto itr = clients_.find(e.window);
+    if (itr == clients_.end()) return;
+
     const Window frame = itr->second;
 
     const int dragX = e.x_root;
@@ -679,8 +851,7 @@ void WindowManager::OnMotionNotify(const XMotionEvent& e){
         int destFrameX = dragStartFrameX_ + deltaX;
         int destFrameY = dragStartFrameY_ + deltaY;
 
-        XMoveWindow(
-            display_,
+        x_->MoveWindow(
             frame,
             destFrameX, destFrameY
         );
@@ -695,8 +866,7 @@ void WindowManager::OnMotionNotify(const XMotionEvent& e){
         int destFrameWidth = dragStartFrameWidth_ + deltaWidth;
         int destFrameHeight = dragStartFrameHeight_ + deltaHeight;
 
-        XResizeWindow(
-            display_,
+        x_->ResizeWindow(
             frame,
             destFrameWidth, destFrameHeight
         );
@@ -704,17 +874,3 @@ void WindowManager::OnMotionNotify(const XMotionEvent& e){
         buildFrame(frame);
     }
 }
-
-int WindowManager::OnXError(Display* display, XErrorEvent* e){
-    const int MAX_ERROR_TEXT_LENGTH = 1024;
-    char error_text[MAX_ERROR_TEXT_LENGTH];
-    XGetErrorText(display, e->error_code, error_text, sizeof(error_text));
-    LOG(ERROR) << "Received X error:\n"
-             << "    Request: " << int(e->request_code)
-             //<< " - " << XRequestCodeToString(e->request_code) << "\n"
-             << "    Error code: " << int(e->error_code)
-             << " - " << error_text << "\n"
-             << "    Resource ID: " << e->resourceid;
-  // The return value is ignored.
-  return 0;
-}
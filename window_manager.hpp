@@ -2,16 +2,39 @@ extern "C"{
 #include <X11/Xlib.h>
 }
 
+#include "backend.hpp"
+#include "stacking.hpp"
+#include "frame_pool.hpp"
+#include "throttle.hpp"
+#include "trace.hpp"
+
 #include <memory>
+#include <functional>
+#include <ctime>
+#include <ostream>
+#include <vector>
 #include <unordered_map>
 #include <map>
 
 class WindowManager{
     private:
-      WindowManager(Display* display);
-      Display* display_;
+      WindowManager(::std::unique_ptr<XBackend> x);
+      ::std::unique_ptr<XBackend> x_; //X server connection, or a fake one
       const Window root_;
       ::std::unordered_map<Window, Window> clients_; //Maps windows to their respective frames
+      StackingManager stacking_; //Local z-order of frames, flushed once per event batch
+      FramePool frames_; //Unmapped frames recycled between clients
+      RequestThrottle throttle_; //Per-client budget for configure/map requests
+      ::std::function<RequestThrottle::Clock::time_point()> clock_; //Time the throttle runs on
+
+      struct HandlerProfile{
+          unsigned long calls;
+          double cpuSeconds;
+          unsigned long requests; //X requests issued
+      };
+      ::std::unique_ptr<TraceWriter> trace_; //Set while recording events
+      bool managed_; //Manage() has framed the existing windows
+      ::std::vector<HandlerProfile> profile_; //Indexed by event type, 0 = end of batch. Empty unless profiling
 
       int dragStartX_;
       int dragStartY_;
@@ -22,6 +45,8 @@ class WindowManager{
 
       void Frame(Window w, bool created_before_wm);
       void Unframe(Window w);
+      StackLayer layerFor(Window w, Window* parent_frame);
+
 
       // Event handlers
       void OnCreateNotify(const XCreateWindowEvent& e);
@@ -37,24 +62,40 @@ class WindowManager{
       void OnMotionNotify(const XMotionEvent& e);
       void OnFocusIn(const XFocusInEvent& e);
       void OnFocusOut(const XFocusOutEvent& e);
+      void OnClientMessage(const XClientMessageEvent& e);
+
+      void applyConfigure(const XConfigureRequestEvent& e);
+      void applyMap(const XMapRequestEvent& e);
+
+      void addProfile(int type, const timespec& start, unsigned long first_request);
+      void writeTraceHeader();
       
       void drawTree(struct node* root, int x, int y, int width, int height);
       void buildFrame(Window frame);
       void tile(Window frame, struct node* root, int x, int y, int width, int height);
       void escapeFrame(Window w);
 
-      // Error handlers
-      static int OnXError(Display* display, XErrorEvent* e); // error handler, passes address to Xlib
-      static int OnWMDetected(Display* display, XErrorEvent* e); // detects if trying to run while another WM is running
-      static bool wm_detected_; // set by OnWMDetected
-
       // Atom consts
       const Atom WM_DELETE_WINDOW;
       const Atom WM_PROTOCOLS;
+      const Atom NET_WM_STATE;
+      const Atom NET_WM_STATE_ABOVE;
+      const Atom NET_WM_STATE_FULLSCREEN;
 
     public: 
-      static ::std::unique_ptr<WindowManager> Create(); //Factory Method
+      static ::std::unique_ptr<WindowManager> Create(const char* display_name = nullptr); //Factory Method
+      static ::std::unique_ptr<WindowManager> Create(::std::unique_ptr<XBackend> x); //Factory Method, eg. for FakeBackend
       ~WindowManager(); //Discnnects from the X server
       void Run(); //Entry point, begins main loop
+
+      // Run() in parts, for replaying recorded events
+      bool Manage(); //Takes over the display and frames existing windows
+      void HandleEvent(const XEvent& e);
+      void EndBatch(); //Applies held back requests and flushes stacking
+      void SetClock(::std::function<RequestThrottle::Clock::time_point()> clock); //eg. a trace's recorded time, default steady_clock
+
+      bool RecordTo(const ::std::string& path); //Writes events handled, and the windows Manage() framed, to a trace file
+      void EnableProfiling(); //Counts CPU time and X requests per handler
+      void WriteProfile(::std::ostream& out) const;
     
 };
\ No newline at end of file
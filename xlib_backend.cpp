@@ -0,0 +1,301 @@
+#include "xlib_backend.hpp"
+
+extern "C"{
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
+}
+
+#include "glog/logging.h"
+#include <poll.h>
+
+using ::std::unique_ptr;
+using ::std::vector;
+
+thread_local bool XlibBackend::wm_detected_;
+::std::mutex XlibBackend::wm_detect_mutex_;
+
+unique_ptr<XlibBackend> XlibBackend::Open(const char* display_name){
+    // 1. Open X display (nullptr = $DISPLAY)
+    Display* display = XOpenDisplay(display_name);
+
+    // error handling for opening display
+    if (display == nullptr){
+        LOG(ERROR) << "Failed to open X display " << XDisplayName(display_name);
+        return nullptr;
+    }
+
+    // A lost display must not take the others in this process down with it
+    XSetIOErrorHandler(&XlibBackend::OnIOError);
+
+    // 2. Wrap connection
+    return unique_ptr<XlibBackend> (new XlibBackend(display));
+}
+
+XlibBackend::XlibBackend(Display* display)
+    : display_(CHECK_NOTNULL(display)),
+      root_(DefaultRootWindow(display_)),
+      lost_(false)
+{
+#ifdef HAVE_XSETIOERROREXITHANDLER
+    XSetIOErrorExitHandler(display_, &XlibBackend::OnIOErrorExit, this);
+#endif
+}
+
+XlibBackend::~XlibBackend(){
+    XCloseDisplay(display_);
+}
+
+Window XlibBackend::Root(){
+    return root_;
+}
+
+const char* XlibBackend::DisplayName(){
+    return XDisplayString(display_);
+}
+
+bool XlibBackend::SelectRootInput(long event_mask){
+    // the error handler is process wide, so displays check one at a time
+    ::std::lock_guard<::std::mutex> detect_lock(wm_detect_mutex_);
+
+    wm_detected_ = false;
+    XSetErrorHandler(&XlibBackend::OnWMDetected); // defer to OnWMDetected if error encountered
+
+    XSelectInput(display_, root_, event_mask);
+    XSync(display_, false);
+
+    //  - set error handler
+    XSetErrorHandler(&XlibBackend::OnXError);
+
+    return !wm_detected_;
+}
+
+bool XlibBackend::NextEvent(XEvent* e){
+    // XNextEvent() cannot tell a lost connection apart, so wait on the socket
+    // and only read events XPending() says are there
+    while (!lost_){
+        if (XPending(display_)){
+            XNextEvent(display_, e);
+            return true;
+        }
+
+        pollfd fd = { ConnectionNumber(display_), POLLIN, 0 };
+        poll(&fd, 1, -1);
+    }
+    return false;
+}
+
+int XlibBackend::Pending(){
+    return XPending(display_);
+}
+
+void XlibBackend::Sync(){
+    XSync(display_, false);
+}
+
+unsigned long XlibBackend::NextRequestSerial(){
+    return NextRequest(display_);
+}
+
+XID XlibBackend::ResourceMask(){
+    return xcb_get_setup(XGetXCBConnection(display_))->resource_id_mask;
+}
+
+void XlibBackend::GrabServer(){
+    XGrabServer(display_);
+}
+
+void XlibBackend::UngrabServer(){
+    XUngrabServer(display_);
+}
+
+Atom XlibBackend::InternAtom(const char* name){
+    return XInternAtom(display_, name, false);
+}
+
+Window XlibBackend::CreateSimpleWindow(Window parent, int x, int y, unsigned int width, unsigned int height,
+                                       unsigned int border_width, unsigned long border, unsigned long background){
+    return XCreateSimpleWindow(display_, parent, x, y, width, height, border_width, border, background);
+}
+
+void XlibBackend::DestroyWindow(Window w){
+    XDestroyWindow(display_, w);
+}
+
+void XlibBackend::SelectInput(Window w, long event_mask){
+    XSelectInput(display_, w, event_mask);
+}
+
+void XlibBackend::MapWindow(Window w){
+    XMapWindow(display_, w);
+}
+
+void XlibBackend::UnmapWindow(Window w){
+    XUnmapWindow(display_, w);
+}
+
+void XlibBackend::ReparentWindow(Window w, Window parent, int x, int y){
+    XReparentWindow(display_, w, parent, x, y);
+}
+
+void XlibBackend::ConfigureWindow(Window w, unsigned int value_mask, XWindowChanges* changes){
+    XConfigureWindow(display_, w, value_mask, changes);
+}
+
+void XlibBackend::MoveWindow(Window w, int x, int y){
+    XMoveWindow(display_, w, x, y);
+}
+
+void XlibBackend::ResizeWindow(Window w, unsigned int width, unsigned int height){
+    XResizeWindow(display_, w, width, height);
+}
+
+void XlibBackend::MoveResizeWindow(Window w, int x, int y, unsigned int width, unsigned int height){
+    XMoveResizeWindow(display_, w, x, y, width, height);
+}
+
+void XlibBackend::RaiseWindow(Window w){
+    XRaiseWindow(display_, w);
+}
+
+void XlibBackend::RestackWindows(Window* windows, int count){
+    XRestackWindows(display_, windows, count);
+}
+
+bool XlibBackend::GetWindowAttributes(Window w, XWindowAttributes* attributes){
+    return XGetWindowAttributes(display_, w, attributes);
+}
+
+bool XlibBackend::GetGeometry(Window w, int* x, int* y, unsigned int* width, unsigned int* height){
+    Window root;
+    unsigned int border_width, depth;
+    return XGetGeometry(display_, w, &root, x, y, width, height, &border_width, &depth);
+}
+
+bool XlibBackend::QueryTree(Window w, vector<Window>& children){
+    Window root, parent, *list = nullptr;
+    unsigned int count = 0;
+
+    children.clear();
+    if (!XQueryTree(display_, w, &root, &parent, &list, &count)) return false;
+
+    children.assign(list, list + count);
+    if (list) XFree(list);
+    return true;
+}
+
+bool XlibBackend::GetTransientForHint(Window w, Window* transient_for){
+    return XGetTransientForHint(display_, w, transient_for);
+}
+
+bool XlibBackend::GetAtomProperty(Window w, Atom property, vector<Atom>& atoms){
+    Atom type;
+    int format;
+    unsigned long count, remaining;
+    unsigned char* data = nullptr;
+
+    atoms.clear();
+    if (XGetWindowProperty(
+            display_, w, property,
+            0, 32, false, XA_ATOM,
+            &type, &format, &count, &remaining, &data
+        ) != Success || !data){
+        return false;
+    }
+
+    const Atom* list = reinterpret_cast<Atom*>(data);
+    atoms.assign(list, list + count);
+    XFree(data);
+    return true;
+}
+
+void XlibBackend::ChangeAtomProperty(Window w, Atom property, const vector<Atom>& atoms){
+    XChangeProperty(
+        display_, w, property, XA_ATOM, 32, PropModeReplace,
+        reinterpret_cast<const unsigned char*>(atoms.data()), atoms.size()
+    );
+}
+
+bool XlibBackend::GetWMProtocols(Window w, vector<Atom>& protocols){
+    Atom* list;
+    int count;
+
+    protocols.clear();
+    if (!XGetWMProtocols(display_, w, &list, &count)) return false;
+
+    protocols.assign(list, list + count);
+    XFree(list);
+    return true;
+}
+
+void XlibBackend::SetInputFocus(Window focus, int revert_to){
+    XSetInputFocus(display_, focus, revert_to, CurrentTime);
+}
+
+void XlibBackend::GetInputFocus(Window* focus, int* revert_to){
+    XGetInputFocus(display_, focus, revert_to);
+}
+
+void XlibBackend::GrabButton(unsigned int button, unsigned int modifiers, Window w, bool owner_events,
+                             unsigned int event_mask, int pointer_mode, int keyboard_mode){
+    XGrabButton(display_, button, modifiers, w, owner_events, event_mask, pointer_mode, keyboard_mode, None, None);
+}
+
+void XlibBackend::GrabKey(int keycode, unsigned int modifiers, Window w, bool owner_events,
+                          int pointer_mode, int keyboard_mode){
+    XGrabKey(display_, keycode, modifiers, w, owner_events, pointer_mode, keyboard_mode);
+}
+
+KeyCode XlibBackend::KeysymToKeycode(KeySym keysym){
+    return XKeysymToKeycode(display_, keysym);
+}
+
+void XlibBackend::AddToSaveSet(Window w){
+    XAddToSaveSet(display_, w);
+}
+
+void XlibBackend::RemoveFromSaveSet(Window w){
+    XRemoveFromSaveSet(display_, w);
+}
+
+bool XlibBackend::SendEvent(Window w, bool propagate, long event_mask, XEvent* e){
+    return XSendEvent(display_, w, propagate, event_mask, e);
+}
+
+void XlibBackend::KillClient(Window w){
+    XKillClient(display_, w);
+}
+
+int XlibBackend::OnWMDetected(Display* display, XErrorEvent* e){
+    // Check error code - should be BadAccess,
+    // anything else comes from another display's thread
+    if (e->error_code != BadAccess) return OnXError(display, e);
+    // Set flag then return
+    wm_detected_ = true;
+    return 0;
+}
+
+int XlibBackend::OnIOError(Display* display){
+    LOG(ERROR) << "Lost connection to X display " << XDisplayString(display);
+    // Xlib exits the process when this returns, unless an exit handler is set
+    return 0;
+}
+
+void XlibBackend::OnIOErrorExit(Display* display, void* backend){
+    // Returning leaves the connection marked broken instead of exiting
+    static_cast<XlibBackend*>(backend)->lost_ = true;
+}
+
+int XlibBackend::OnXError(Display* display, XErrorEvent* e){
+    const int MAX_ERROR_TEXT_LENGTH = 1024;
+    char error_text[MAX_ERROR_TEXT_LENGTH];
+    XGetErrorText(display, e->error_code, error_text, sizeof(error_text));
+    LOG(ERROR) << "Received X error:\n"
+             << "    Request: " << int(e->request_code)
+             //<< " - " << XRequestCodeToString(e->request_code) << "\n"
+             << "    Error code: " << int(e->error_code)
+             << " - " << error_text << "\n"
+             << "    Resource ID: " << e->resourceid;
+  // The return value is ignored.
+  return 0;
+}
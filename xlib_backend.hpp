@@ -0,0 +1,73 @@
+#pragma once
+
+#include "backend.hpp"
+
+#include <memory>
+#include <mutex>
+
+// XBackend on a real X server connection
+class XlibBackend : public XBackend{
+    private:
+      XlibBackend(Display* display);
+      Display* display_;
+      const Window root_;
+      bool lost_; // set once the connection has failed, see OnIOErrorExit
+
+      // Error handlers
+      static int OnXError(Display* display, XErrorEvent* e); // error handler, passes address to Xlib
+      static int OnWMDetected(Display* display, XErrorEvent* e); // detects if trying to run while another WM is running
+      static int OnIOError(Display* display); // logs a failed connection, process wide
+      static void OnIOErrorExit(Display* display, void* backend); // replaces Xlib's exit() for this display only
+      static thread_local bool wm_detected_; // set by OnWMDetected, per display thread
+      static ::std::mutex wm_detect_mutex_; // one display at a time swaps in OnWMDetected
+
+    public:
+      static ::std::unique_ptr<XlibBackend> Open(const char* display_name = nullptr); //Factory Method
+      ~XlibBackend(); //Disconnects from the X server
+
+      Window Root() override;
+      const char* DisplayName() override;
+      bool SelectRootInput(long event_mask) override;
+      bool NextEvent(XEvent* e) override;
+      int Pending() override;
+      void Sync() override;
+      unsigned long NextRequestSerial() override;
+      XID ResourceMask() override;
+      void GrabServer() override;
+      void UngrabServer() override;
+      Atom InternAtom(const char* name) override;
+
+      Window CreateSimpleWindow(Window parent, int x, int y, unsigned int width, unsigned int height,
+                                unsigned int border_width, unsigned long border, unsigned long background) override;
+      void DestroyWindow(Window w) override;
+      void SelectInput(Window w, long event_mask) override;
+      void MapWindow(Window w) override;
+      void UnmapWindow(Window w) override;
+      void ReparentWindow(Window w, Window parent, int x, int y) override;
+      void ConfigureWindow(Window w, unsigned int value_mask, XWindowChanges* changes) override;
+      void MoveWindow(Window w, int x, int y) override;
+      void ResizeWindow(Window w, unsigned int width, unsigned int height) override;
+      void MoveResizeWindow(Window w, int x, int y, unsigned int width, unsigned int height) override;
+      void RaiseWindow(Window w) override;
+      void RestackWindows(Window* windows, int count) override;
+      bool GetWindowAttributes(Window w, XWindowAttributes* attributes) override;
+      bool GetGeometry(Window w, int* x, int* y, unsigned int* width, unsigned int* height) override;
+      bool QueryTree(Window w, ::std::vector<Window>& children) override;
+
+      bool GetTransientForHint(Window w, Window* transient_for) override;
+      bool GetAtomProperty(Window w, Atom property, ::std::vector<Atom>& atoms) override;
+      void ChangeAtomProperty(Window w, Atom property, const ::std::vector<Atom>& atoms) override;
+      bool GetWMProtocols(Window w, ::std::vector<Atom>& protocols) override;
+
+      void SetInputFocus(Window focus, int revert_to) override;
+      void GetInputFocus(Window* focus, int* revert_to) override;
+      void GrabButton(unsigned int button, unsigned int modifiers, Window w, bool owner_events,
+                      unsigned int event_mask, int pointer_mode, int keyboard_mode) override;
+      void GrabKey(int keycode, unsigned int modifiers, Window w, bool owner_events,
+                   int pointer_mode, int keyboard_mode) override;
+      KeyCode KeysymToKeycode(KeySym keysym) override;
+      void AddToSaveSet(Window w) override;
+      void RemoveFromSaveSet(Window w) override;
+      bool SendEvent(Window w, bool propagate, long event_mask, XEvent* e) override;
+      void KillClient(Window w) override;
+};